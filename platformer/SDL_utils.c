@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include "SDL_utils.h"
 
+u64 SDL_draw_calls = 0;
+
 void SDL_fail() {
     printf("SDL ERROR: %s\n", SDL_GetError());
     exit(1);
@@ -20,7 +22,9 @@ void SDL_init(
         SDL_WINDOW_ALLOW_HIGHDPI
     );
     if (!*window) { SDL_fail(); }
-    *renderer = SDL_CreateRenderer(*window, -1, SDL_RENDERER_ACCELERATED);
+    *renderer = SDL_CreateRenderer(
+        *window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC
+    );
     if (!*renderer) { SDL_fail(); }
 
     TTF_Init();
@@ -58,6 +62,7 @@ void SDL_get_window_scale(
 }
 
 int SDL_ScaledRenderDrawLine(SDL_ScaledRenderer scaled_renderer, int x1, int y1, int x2, int y2) {
+    SDL_draw_calls++;
     return SDL_RenderDrawLine(
         scaled_renderer.renderer,
         scaled_renderer.xs * x1,
@@ -78,11 +83,13 @@ SDL_Rect SDL_ScaleRect(SDL_ScaledRenderer scaled_renderer, SDL_Rect rect) {
 
 int SDL_ScaledRenderFillRect(SDL_ScaledRenderer scaled_renderer, const SDL_Rect *rect) {
     SDL_Rect scaled_rect = SDL_ScaleRect(scaled_renderer, *rect);
+    SDL_draw_calls++;
     return SDL_RenderFillRect(scaled_renderer.renderer, &scaled_rect);
 }
 
 int SDL_ScaledRenderDrawRect(SDL_ScaledRenderer scaled_renderer, const SDL_Rect *rect) {
     SDL_Rect scaled_rect = SDL_ScaleRect(scaled_renderer, *rect);
+    SDL_draw_calls++;
     return SDL_RenderDrawRect(scaled_renderer.renderer, &scaled_rect);
 }
 
@@ -92,6 +99,7 @@ int SDL_ScaledRenderCopy(
     const SDL_Rect *srcrect,
     const SDL_Rect *dstrect
 ) {
+    SDL_draw_calls++;
     if (dstrect == NULL) {
         return SDL_RenderCopy(scaled_renderer.renderer, texture, srcrect, dstrect);
     }
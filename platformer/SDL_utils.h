@@ -16,6 +16,9 @@ typedef struct {
     int w, h;
 } Window;
 
+// number of calls to SDL made by the ScaledRenderer functions, for benchmarks
+extern u64 SDL_draw_calls;
+
 void SDL_fail(void);
 void SDL_init(
     SDL_Window **window,
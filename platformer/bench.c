@@ -0,0 +1,138 @@
+/**
+ * Renders frames through the draw paths of the game with SDL's software
+ * renderer into an offscreen surface, no window or GPU needed.
+ *
+ *     ./bench [frames [stage.bin]]
+ *
+ * The camera pans across the stage (by default a generated 1000x300 stage,
+ * seed 1) with the grid and the player shown. Prints the time and number of
+ * draw calls per frame for every draw path, and the frames per second.
+ */
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SDL_utils.h"
+#include "generator.h"
+#include "stage.h"
+#include "types.h"
+
+#define SCREEN_WIDTH 1280
+#define SCREEN_HEIGHT 720
+#define PLAYER_SIZE 20
+#define TILE_SIZE 40
+// camera speed in pixels per frame
+#define PAN_X 7
+#define PAN_Y 3
+
+typedef enum {
+    PASS_STAGE,
+    PASS_GRID,
+    PASS_PLAYER,
+    PASS_COUNT,
+} PassType;
+
+static const char *PASS_NAMES[PASS_COUNT] = {"stage", "grid", "player"};
+
+typedef struct {
+    u64 time;  // in performance counter units
+    u64 calls;
+} Pass;
+
+/**
+ * Position along a back and forth sweep of `length` pixels.
+ */
+static i32 sweep(u64 distance, i64 length) {
+    if (length <= 0) {
+        return 0;
+    }
+    i64 position = distance % (2 * length);
+    return position < length ? position : 2 * length - position;
+}
+
+static void Pass_begin(u64 *start, u64 *calls) {
+    *start = SDL_GetPerformanceCounter();
+    *calls = SDL_draw_calls;
+}
+
+static void Pass_end(Pass *pass, u64 start, u64 calls) {
+    pass->time += SDL_GetPerformanceCounter() - start;
+    pass->calls += SDL_draw_calls - calls;
+}
+
+int main(int argc, char **argv) {
+    u64 frames = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000;
+    if (frames == 0) {
+        printf("Usage: %s [frames [stage.bin]]\n", argv[0]);
+        return 1;
+    }
+    Stage stage;
+    if (argc > 2) {
+        Stage_load(&stage, argv[2]);
+    } else {
+        Generator_generate(&stage, 1000, 300, 1);
+    }
+
+    // draw calls are executed right away instead of being queued until the
+    // frame is presented, so that every pass is timed on its own
+    SDL_SetHint(SDL_HINT_RENDER_BATCHING, "0");
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(
+        0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_RGBA8888
+    );
+    if (surface == NULL) { SDL_fail(); }
+    SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(surface);
+    if (renderer == NULL) { SDL_fail(); }
+    SDL_ScaledRenderer scaled_renderer = {renderer, 1, 1};
+    SDL_Texture *tile_atlas = TileAtlas_create(renderer);
+
+    Pass passes[PASS_COUNT] = {0};
+    i64 max_x = (i64)stage.width * TILE_SIZE - SCREEN_WIDTH;
+    i64 max_y = (i64)stage.height * TILE_SIZE - SCREEN_HEIGHT;
+    u64 start = SDL_GetPerformanceCounter();
+    for (u64 frame = 0; frame < frames; frame++) {
+        Camera camera = {sweep(frame * PAN_X, max_x), sweep(frame * PAN_Y, max_y), 0};
+        Player player = {
+            .x = camera.x + (SCREEN_WIDTH - PLAYER_SIZE) / 2,
+            .y = camera.y + (SCREEN_HEIGHT - PLAYER_SIZE) / 2,
+            .dx = 0,
+            .dy = 0,
+            .show = true
+        };
+        SDL_SetRenderDrawColor(renderer, 128, 128, 128, 255);
+        SDL_RenderClear(renderer);
+        u64 pass_start, pass_calls;
+        Pass_begin(&pass_start, &pass_calls);
+        Stage_draw(&stage, scaled_renderer, camera, tile_atlas);
+        Pass_end(&passes[PASS_STAGE], pass_start, pass_calls);
+        Pass_begin(&pass_start, &pass_calls);
+        show_grid(scaled_renderer, camera);
+        Pass_end(&passes[PASS_GRID], pass_start, pass_calls);
+        Pass_begin(&pass_start, &pass_calls);
+        Player_render(player, scaled_renderer, camera);
+        Pass_end(&passes[PASS_PLAYER], pass_start, pass_calls);
+        SDL_RenderPresent(renderer);
+    }
+    f64 ms = 1000. / SDL_GetPerformanceFrequency();
+    f64 total_ms = (SDL_GetPerformanceCounter() - start) * ms;
+
+    printf(
+        "Stage %lux%lu, %lu frames of %dx%d with the software renderer\n",
+        stage.width, stage.height, frames, SCREEN_WIDTH, SCREEN_HEIGHT
+    );
+    for (int i = 0; i < PASS_COUNT; i++) {
+        printf(
+            "  %-8s %8.3f ms/frame %10.1f calls/frame\n",
+            PASS_NAMES[i], passes[i].time * ms / frames, (f64)passes[i].calls / frames
+        );
+    }
+    printf(
+        "  %-8s %8.3f ms/frame %10.1f calls/frame, %.1f fps\n",
+        "total", total_ms / frames, (f64)SDL_draw_calls / frames, frames * 1000. / total_ms
+    );
+
+    SDL_DestroyTexture(tile_atlas);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    Stage_destroy(&stage);
+    return 0;
+}
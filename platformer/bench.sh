@@ -0,0 +1,7 @@
+gcc bench.c SDL_utils.c generator.c stage.c \
+    -o bench \
+    -O2 -g \
+    -Wall -Wextra -Wunreachable-code \
+    `pkg-config --cflags --libs sdl2 SDL2_image SDL2_mixer SDL2_ttf` \
+    -DSDL_DISABLE_IMMINTRIN_H \
+    && ./bench "$@"
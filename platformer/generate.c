@@ -0,0 +1,38 @@
+/**
+ * Generates a stage and saves it.
+ *
+ *     ./generate [stage.bin [width height [seed]]]
+ *
+ * By default a 10000x1000 stage is written to "stages/generated.bin" with
+ * seed 1.
+ */
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "generator.h"
+#include "stage.h"
+#include "types.h"
+
+int main(int argc, char **argv) {
+    const char *file_name = argc > 1 ? argv[1] : "stages/generated.bin";
+    u64 width = argc > 3 ? strtoull(argv[2], NULL, 10) : 10000;
+    u64 height = argc > 3 ? strtoull(argv[3], NULL, 10) : 1000;
+    u64 seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 1;
+    if (width == 0 || height == 0) {
+        printf("Usage: %s [stage.bin [width height [seed]]]\n", argv[0]);
+        return 1;
+    }
+
+    u64 start = SDL_GetPerformanceCounter();
+    Stage stage;
+    Generator_generate(&stage, width, height, seed);
+    f64 generate_ms = (SDL_GetPerformanceCounter() - start) * 1000. / SDL_GetPerformanceFrequency();
+    Stage_save(&stage, file_name);
+    printf(
+        "Generated %s (%lux%lu, seed %lu) in %.2f ms on %d threads\n",
+        file_name, width, height, seed, generate_ms, SDL_GetCPUCount()
+    );
+    Stage_destroy(&stage);
+    return 0;
+}
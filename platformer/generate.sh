@@ -0,0 +1,7 @@
+gcc generate.c generator.c SDL_utils.c stage.c \
+    -o generate \
+    -O2 -g \
+    -Wall -Wextra -Wunreachable-code \
+    `pkg-config --cflags --libs sdl2 SDL2_image SDL2_mixer SDL2_ttf` \
+    -DSDL_DISABLE_IMMINTRIN_H \
+    && ./generate "$@"
@@ -0,0 +1,303 @@
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include "generator.h"
+
+/**
+ * The stage is generated in passes over a bit-packed grid with one word of
+ * walls on the left and right and one row of walls above and below, so that
+ * every row can be processed a word at a time without bounds checks. Rows are
+ * split into bands processed by one thread each.
+ *
+ * 1. random fill, a tile is a wall with a probability of 3/8
+ * 2. cellular automaton: a tile becomes a wall when at least 5 of its 8
+ *    neighbours are walls, and stays one with 4
+ * 3. platforms in open areas, every `PLATFORM_SPACING` rows, as steps to
+ *    climb tall caves; only tiles with `PLATFORM_SPACING + 2` open rows get
+ *    one, so a cave can still be too high or too wide to climb out of
+ * 4. caves that do not connect to the largest one are filled, since the
+ *    player can never get in there; this pass runs on a single thread
+ */
+#define WORD_BITS 64
+#define SMOOTHING_STEPS 4
+// rows between platforms, the player jumps a little over 3 tiles
+#define PLATFORM_SPACING 3
+#define PLATFORM_LENGTH 8
+
+typedef struct {
+    u64 width, height;
+    u64 stride;  // in words, including the two walls
+    u64 seed;
+    u64 *src, *dst;
+} Grid;
+
+typedef struct {
+    Grid *grid;
+    u64 first_row, last_row;  // padded rows, exclusive end
+} Band;
+
+static inline u64 words_for(u64 bits) {
+    return (bits + WORD_BITS - 1) / WORD_BITS;
+}
+
+// splitmix64, random bits depend only on the seed and the position
+static inline u64 hash(u64 seed, u64 row, u64 word) {
+    u64 x = seed + row * 0x9e3779b97f4a7c15 + word * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+/**
+ * Make the bits past the last column of the row walls.
+ */
+static inline void Grid_close_row(const Grid *grid, u64 *row) {
+    u64 tail_bits = grid->width % WORD_BITS;
+    if (tail_bits != 0) {
+        row[grid->stride - 2] |= ~(u64)0 << tail_bits;
+    }
+}
+
+static void Grid_fill_row(Grid *grid, u64 r) {
+    u64 *row = grid->dst + r * grid->stride;
+    for (u64 w = 1; w + 1 < grid->stride; w++) {
+        u64 a = hash(grid->seed, r, 4 * w), b = hash(grid->seed, r, 4 * w + 1);
+        u64 c = hash(grid->seed, r, 4 * w + 2);
+        row[w] = a & ~(b & c);
+    }
+    Grid_close_row(grid, row);
+}
+
+// add one bit to every column of the bit-sliced counters
+static inline void count_add(u64 *count, u64 bits) {
+    u64 carry = bits;
+    for (int i = 0; i < 3; i++) {
+        u64 next = count[i] & carry;
+        count[i] ^= carry;
+        carry = next;
+    }
+    count[3] |= carry;
+}
+
+static void Grid_smooth_row(Grid *grid, u64 r) {
+    const u64 *rows[3] = {
+        grid->src + (r - 1) * grid->stride,
+        grid->src + r * grid->stride,
+        grid->src + (r + 1) * grid->stride,
+    };
+    u64 *out = grid->dst + r * grid->stride;
+    for (u64 w = 1; w + 1 < grid->stride; w++) {
+        // bit i of count[k] is bit k of the number of walls around column i
+        u64 count[4] = {0, 0, 0, 0};
+        for (int i = 0; i < 3; i++) {
+            const u64 *row = rows[i];
+            count_add(count, (row[w] << 1) | (row[w - 1] >> 63));
+            count_add(count, (row[w] >> 1) | (row[w + 1] << 63));
+            if (i != 1) {
+                count_add(count, row[w]);
+            }
+        }
+        u64 at_least_5 = count[3] | (count[2] & (count[1] | count[0]));
+        u64 exactly_4 = count[2] & ~(count[3] | count[1] | count[0]);
+        out[w] = at_least_5 | (exactly_4 & rows[1][w]);
+    }
+    Grid_close_row(grid, out);
+}
+
+static void Grid_platform_row(Grid *grid, u64 r) {
+    const u64 *row = grid->src + r * grid->stride;
+    u64 *out = grid->dst + r * grid->stride;
+    memcpy(out, row, sizeof(u64) * grid->stride);
+    if (r % PLATFORM_SPACING != 0 || r + PLATFORM_SPACING > grid->height + 1) {
+        return;
+    }
+    const u64 *above = row - grid->stride;
+    u64 seed = ~grid->seed;
+    for (u64 w = 1; w + 1 < grid->stride; w++) {
+        // empty from the row above down to the next platform row
+        u64 open = ~above[w];
+        for (u64 i = 0; i <= PLATFORM_SPACING; i++) {
+            open &= ~row[w + i * grid->stride];
+        }
+        // platforms start on about one tile in 16
+        u64 starts = hash(seed, r, 4 * w) & hash(seed, r, 4 * w + 1)
+            & hash(seed, r, 4 * w + 2) & hash(seed, r, 4 * w + 3);
+        u64 platforms = starts;
+        for (int i = 1; i < PLATFORM_LENGTH; i++) {
+            platforms |= starts << i;
+        }
+        out[w] = row[w] | (platforms & open);
+    }
+}
+
+typedef struct {
+    u64 *items;
+    size_t count, capacity;
+} SeedStack;
+
+static void SeedStack_push(SeedStack *stack, u64 seed) {
+    if (stack->count == stack->capacity) {
+        stack->capacity = stack->capacity ? 2 * stack->capacity : 1024;
+        stack->items = realloc(stack->items, sizeof(u64) * stack->capacity);
+    }
+    stack->items[stack->count++] = seed;
+}
+
+// the bits of word `w` from column `first` to `last` included
+static inline u64 span_mask(u64 w, u64 first, u64 last) {
+    u64 lo = w == first / WORD_BITS ? first % WORD_BITS : 0;
+    u64 hi = w == last / WORD_BITS ? last % WORD_BITS : WORD_BITS - 1;
+    return (~(u64)0 << lo) & (~(u64)0 >> (WORD_BITS - 1 - hi));
+}
+
+/**
+ * Set the bits of the group of connected 0 bits of `marks` around (`row`,
+ * `col`), a span of a row at a time, and return how many there were. Columns
+ * count from the left wall word, and the walls stop the fill.
+ */
+static u64 Grid_flood(const Grid *grid, u64 *marks, u64 row, u64 col, SeedStack *stack) {
+    u64 row_bits = grid->stride * WORD_BITS;
+    u64 size = 0;
+    SeedStack_push(stack, row * row_bits + col);
+    while (stack->count > 0) {
+        u64 seed = stack->items[--stack->count];
+        u64 r = seed / row_bits, c = seed % row_bits;
+        u64 *line = marks + r * grid->stride;
+        if ((line[c / WORD_BITS] >> (c % WORD_BITS)) & 1) { continue; }
+        // closest set bits on both sides
+        u64 w = c / WORD_BITS;
+        u64 closed = line[w] & ~(~(u64)0 << (c % WORD_BITS));
+        while (closed == 0) { closed = line[--w]; }
+        u64 left = w * WORD_BITS + (WORD_BITS - __builtin_clzll(closed));
+        w = c / WORD_BITS;
+        closed = line[w] & (~(u64)0 << (c % WORD_BITS));
+        while (closed == 0) { closed = line[++w]; }
+        u64 right = w * WORD_BITS + __builtin_ctzll(closed) - 1;
+        size += right - left + 1;
+        for (w = left / WORD_BITS; w <= right / WORD_BITS; w++) {
+            line[w] |= span_mask(w, left, right);
+        }
+        // one seed per span of open bits touching this one above and below
+        u64 next_rows[2] = {r - 1, r + 1};
+        for (int n = 0; n < 2; n++) {
+            const u64 *next = marks + next_rows[n] * grid->stride;
+            u64 carry = 0;
+            for (w = left / WORD_BITS; w <= right / WORD_BITS; w++) {
+                u64 open = ~next[w] & span_mask(w, left, right);
+                u64 starts = open & ~((open << 1) | carry);
+                carry = open >> (WORD_BITS - 1);
+                for (; starts != 0; starts &= starts - 1) {
+                    SeedStack_push(stack, next_rows[n] * row_bits + w * WORD_BITS + __builtin_ctzll(starts));
+                }
+            }
+        }
+    }
+    return size;
+}
+
+/**
+ * Fill every cave but the largest one. Caves are found by flooding a copy of
+ * the grid in `dst`, then all but the largest are flooded again in `src`,
+ * which turns them into walls.
+ */
+static void Grid_fill_sealed_caves(Grid *grid) {
+    SeedStack stack = {NULL, 0, 0}, caves = {NULL, 0, 0};
+    u64 largest = 0;
+    size_t largest_index = 0;
+    memcpy(grid->dst, grid->src, sizeof(u64) * grid->stride * (grid->height + 2));
+    for (u64 r = 1; r <= grid->height; r++) {
+        u64 *row = grid->dst + r * grid->stride;
+        for (u64 w = 1; w + 1 < grid->stride; w++) {
+            while (~row[w] != 0) {
+                u64 col = w * WORD_BITS + __builtin_ctzll(~row[w]);
+                u64 size = Grid_flood(grid, grid->dst, r, col, &stack);
+                if (size > largest) {
+                    largest = size;
+                    largest_index = caves.count;
+                }
+                SeedStack_push(&caves, r * grid->stride * WORD_BITS + col);
+            }
+        }
+    }
+    u64 row_bits = grid->stride * WORD_BITS;
+    for (size_t i = 0; i < caves.count; i++) {
+        if (i != largest_index) {
+            Grid_flood(grid, grid->src, caves.items[i] / row_bits, caves.items[i] % row_bits, &stack);
+        }
+    }
+    free(caves.items);
+    free(stack.items);
+}
+
+typedef void (*RowPass)(Grid *grid, u64 r);
+
+typedef struct {
+    Band band;
+    RowPass pass;
+} Job;
+
+static int Generator_worker(void *data) {
+    Job *job = data;
+    for (u64 r = job->band.first_row; r < job->band.last_row; r++) {
+        job->pass(job->band.grid, r);
+    }
+    return 0;
+}
+
+/**
+ * Run `pass` over every row of the grid (not the walls), reading `src` and
+ * writing `dst`, then swap them.
+ */
+static void Grid_run_pass(Grid *grid, RowPass pass, int thread_count) {
+    SDL_Thread *threads[thread_count];
+    Job jobs[thread_count];
+    u64 rows_per_band = (grid->height + thread_count - 1) / thread_count;
+    for (int i = 0; i < thread_count; i++) {
+        u64 first = 1 + i * rows_per_band, last = first + rows_per_band;
+        if (first > grid->height + 1) { first = grid->height + 1; }
+        if (last > grid->height + 1) { last = grid->height + 1; }
+        jobs[i] = (Job){{grid, first, last}, pass};
+        threads[i] = SDL_CreateThread(Generator_worker, "generator", &jobs[i]);
+        if (threads[i] == NULL) { SDL_fail(); }
+    }
+    for (int i = 0; i < thread_count; i++) {
+        SDL_WaitThread(threads[i], NULL);
+    }
+    u64 *src = grid->src;
+    grid->src = grid->dst;
+    grid->dst = src;
+}
+
+void Generator_generate(Stage *stage, u64 width, u64 height, u64 seed) {
+    Grid grid = {
+        .width = width,
+        .height = height,
+        .stride = words_for(width) + 2,
+        .seed = seed
+    };
+    size_t grid_size = sizeof(u64) * grid.stride * (height + 2);
+    grid.src = malloc(grid_size);
+    grid.dst = malloc(grid_size);
+    // walls all around, in both buffers, the passes only write the inside
+    memset(grid.src, 0xff, grid_size);
+    memset(grid.dst, 0xff, grid_size);
+
+    int thread_count = SDL_GetCPUCount();
+    Grid_run_pass(&grid, Grid_fill_row, thread_count);
+    for (int i = 0; i < SMOOTHING_STEPS; i++) {
+        Grid_run_pass(&grid, Grid_smooth_row, thread_count);
+    }
+    Grid_run_pass(&grid, Grid_platform_row, thread_count);
+    Grid_fill_sealed_caves(&grid);
+
+    TileRegion region = {
+        .width = width,
+        .height = height,
+        .stride = grid.stride,
+        .bits = grid.src + grid.stride + 1
+    };
+    Stage_alloc(stage, width, height);
+    Stage_blit_region(stage, &region, 0, 0, BLIT_MODE_PASTE);
+    free(grid.src);
+    free(grid.dst);
+}
@@ -0,0 +1,13 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "stage.h"
+#include "types.h"
+
+/**
+ * Fill `stage` with a new `width` x `height` cave. The same seed always gives
+ * the same stage, whatever the number of threads.
+ */
+void Generator_generate(Stage *stage, u64 width, u64 height, u64 seed);
+
+#endif // GENERATOR_H
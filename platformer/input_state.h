@@ -6,6 +6,7 @@ typedef struct {
     bool left_down;
     bool right_down;
     bool space_down;
+    bool rewind_down;
 } InputState;
 
 #endif // INPUT_STATE
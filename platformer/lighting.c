@@ -0,0 +1,294 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lighting.h"
+
+#define SCREEN_WIDTH 1280
+#define SCREEN_HEIGHT 720
+#define PLAYER_SIZE 20
+#define TILE_SIZE 40
+
+// Every light is cast over a square patch of tiles centered on it, small
+// enough for every row and column of the patch to fit into a single word.
+#define PATCH_SIZE (2 * LIGHT_RADIUS + 1)
+// darkness (alpha) of the tiles no light reaches
+#define AMBIENT_DARKNESS 235
+
+static u8 falloff[PATCH_SIZE][PATCH_SIZE];
+
+static inline i64 floor_div(i64 a, i64 b) {
+    i64 q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+static inline i64 ceil_div(i64 a, i64 b) {
+    return -floor_div(-a, b);
+}
+
+/**
+ * Shadowcasting works on quadrants: rows of tiles at increasing `depth` from
+ * the light, with columns going from `-depth` to `depth`. Slopes are kept as
+ * fractions so that the scan is exact.
+ */
+typedef struct {
+    i64 num, den;  // den > 0
+} Slope;
+
+static inline Slope tile_slope(i64 depth, i64 col) {
+    return (Slope){2 * col - 1, 2 * depth};
+}
+
+// depth * slope rounded to the nearest column, ties go up
+static inline i64 round_ties_up(i64 depth, Slope slope) {
+    return floor_div(2 * depth * slope.num + slope.den, 2 * slope.den);
+}
+
+// depth * slope rounded to the nearest column, ties go down
+static inline i64 round_ties_down(i64 depth, Slope slope) {
+    return ceil_div(2 * depth * slope.num - slope.den, 2 * slope.den);
+}
+
+// bits from `from` to `to`, inclusive
+static inline u64 bit_range(i64 from, i64 to) {
+    u64 upper = to >= 63 ? ~(u64)0 : ((u64)1 << (to + 1)) - 1;
+    return upper & ~(((u64)1 << from) - 1);
+}
+
+/**
+ * Last bit of the run of equal bits starting at `bit`, at most `last_bit`.
+ */
+static inline i64 run_end(u64 line, i64 bit, i64 last_bit) {
+    u64 different = (((line >> bit) & 1) ? ~line : line) >> bit;
+    i64 end = different ? bit + __builtin_ctzll(different) - 1 : 63;
+    return end < last_bit ? end : last_bit;
+}
+
+/**
+ * A quadrant of the patch. Depth `d` maps to the line
+ * `LIGHT_RADIUS + direction * d` of `walls` and column `c` maps to the bit
+ * `LIGHT_RADIUS + c` of that line.
+ */
+typedef struct {
+    const u64 *walls;
+    u64 *visible;
+    i64 direction;
+} Quadrant;
+
+/**
+ * Symmetric shadowcasting of one row of a quadrant. Instead of visiting every
+ * tile, the row is walked run by run: a whole run of walls or floors is
+ * revealed with a single mask.
+ */
+static void Lighting_scan(const Quadrant *quadrant, i64 depth, Slope start, Slope end) {
+    if (depth > LIGHT_RADIUS) {
+        return;
+    }
+    i64 min_col = round_ties_up(depth, start);
+    i64 max_col = round_ties_down(depth, end);
+    if (min_col > max_col) {
+        return;
+    }
+    i64 line_index = LIGHT_RADIUS + quadrant->direction * depth;
+    u64 line = quadrant->walls[line_index];
+    u64 visible = 0;
+    int prev = -1; // -1 before the first run, 0 after floors, 1 after walls
+    for (i64 col = min_col; col <= max_col;) {
+        i64 bit = LIGHT_RADIUS + col;
+        bool wall = (line >> bit) & 1;
+        i64 last = run_end(line, bit, LIGHT_RADIUS + max_col) - LIGHT_RADIUS;
+        if (wall) {
+            visible |= bit_range(bit, LIGHT_RADIUS + last);
+            if (prev == 0) {
+                Lighting_scan(quadrant, depth + 1, start, tile_slope(depth, col));
+            }
+        } else {
+            if (prev == 1) {
+                start = tile_slope(depth, col);
+            }
+            // floors are lit only when the light could also be seen from them
+            i64 lo = ceil_div(depth * start.num, start.den);
+            i64 hi = floor_div(depth * end.num, end.den);
+            lo = lo > col ? lo : col;
+            hi = hi < last ? hi : last;
+            if (lo <= hi) {
+                visible |= bit_range(LIGHT_RADIUS + lo, LIGHT_RADIUS + hi);
+            }
+        }
+        prev = wall;
+        col = last + 1;
+    }
+    quadrant->visible[line_index] |= visible;
+    if (prev == 0) {
+        Lighting_scan(quadrant, depth + 1, start, end);
+    }
+}
+
+static void transpose(const u64 *lines, u64 *transposed) {
+    for (int i = 0; i < PATCH_SIZE; i++) {
+        for (u64 bits = lines[i]; bits != 0; bits &= bits - 1) {
+            int j = __builtin_ctzll(bits);
+            if (j < PATCH_SIZE) {
+                transposed[j] |= (u64)1 << i;
+            }
+        }
+    }
+}
+
+/**
+ * Cast the light from the tile (light_col, light_row) and add it to the light
+ * levels of the window.
+ */
+static void Lighting_cast(Lighting *lighting, const Stage *stage, i64 light_col, i64 light_row) {
+    i64 patch_col = light_col - LIGHT_RADIUS, patch_row = light_row - LIGHT_RADIUS;
+    if (patch_col + PATCH_SIZE <= lighting->origin_col
+        || patch_row + PATCH_SIZE <= lighting->origin_row
+        || patch_col >= lighting->origin_col + (i64)lighting->width
+        || patch_row >= lighting->origin_row + (i64)lighting->height) {
+        return;
+    }
+
+    u64 rows[PATCH_SIZE], cols[PATCH_SIZE] = {0};
+    u64 visible_rows[PATCH_SIZE] = {0}, visible_cols[PATCH_SIZE] = {0};
+    for (int i = 0; i < PATCH_SIZE; i++) {
+        rows[i] = Stage_read_tiles(stage, patch_row + i, patch_col, PATCH_SIZE);
+    }
+    transpose(rows, cols);
+
+    Quadrant quadrants[] = {
+        {rows, visible_rows, -1}, // north
+        {rows, visible_rows, 1},  // south
+        {cols, visible_cols, -1}, // west
+        {cols, visible_cols, 1},  // east
+    };
+    for (int i = 0; i < 4; i++) {
+        Lighting_scan(&quadrants[i], 1, (Slope){-1, 1}, (Slope){1, 1});
+    }
+    transpose(visible_cols, visible_rows);
+    visible_rows[LIGHT_RADIUS] |= (u64)1 << LIGHT_RADIUS;
+
+    for (int i = 0; i < PATCH_SIZE; i++) {
+        i64 r = patch_row + i - lighting->origin_row;
+        if (r < 0 || r >= (i64)lighting->height) { continue; }
+        u8 *levels = lighting->levels + r * lighting->width;
+        for (u64 bits = visible_rows[i]; bits != 0; bits &= bits - 1) {
+            int j = __builtin_ctzll(bits);
+            i64 c = patch_col + j - lighting->origin_col;
+            if (c < 0 || c >= (i64)lighting->width) { continue; }
+            if (falloff[i][j] > levels[c]) {
+                levels[c] = falloff[i][j];
+            }
+        }
+    }
+}
+
+void Lighting_init(Lighting *lighting, SDL_Renderer *renderer) {
+    for (int i = 0; i < PATCH_SIZE; i++) {
+        for (int j = 0; j < PATCH_SIZE; j++) {
+            f32 distance = hypotf(i - LIGHT_RADIUS, j - LIGHT_RADIUS);
+            falloff[i][j] = distance > LIGHT_RADIUS ? 0 : 255 * (1 - distance / (LIGHT_RADIUS + 1));
+        }
+    }
+    // one extra row and column for when the camera is between tiles
+    lighting->width = SCREEN_WIDTH / TILE_SIZE + 1;
+    lighting->height = SCREEN_HEIGHT / TILE_SIZE + 1;
+    lighting->levels = malloc(sizeof(u8) * lighting->width * lighting->height);
+    lighting->pixels = malloc(sizeof(u32) * lighting->width * lighting->height);
+    lighting->texture = SDL_CreateTexture(
+        renderer,
+        SDL_PIXELFORMAT_RGBA8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        lighting->width,
+        lighting->height
+    );
+    if (lighting->texture == NULL) { SDL_fail(); }
+    SDL_SetTextureBlendMode(lighting->texture, SDL_BLENDMODE_BLEND);
+    // smooth the light between tile centers
+    SDL_SetTextureScaleMode(lighting->texture, SDL_ScaleModeLinear);
+    lighting->light_count = 0;
+    lighting->last_update_ms = 0;
+    lighting->dirty = true;
+}
+
+void Lighting_destroy(Lighting *lighting) {
+    SDL_DestroyTexture(lighting->texture);
+    lighting->texture = NULL;
+    free(lighting->levels);
+    free(lighting->pixels);
+    lighting->levels = NULL;
+    lighting->pixels = NULL;
+}
+
+/**
+ * Force the next update to recompute the lighting, e.g. after tiles change.
+ */
+void Lighting_invalidate(Lighting *lighting) {
+    lighting->dirty = true;
+}
+
+void Lighting_clear_lights(Lighting *lighting) {
+    lighting->light_count = 0;
+    lighting->dirty = true;
+}
+
+/**
+ * Place a light source on the tile or remove the one that is already there.
+ */
+void Lighting_toggle_light(Lighting *lighting, i64 col, i64 row) {
+    lighting->dirty = true;
+    for (size_t i = 0; i < lighting->light_count; i++) {
+        if (lighting->lights[i].col == col && lighting->lights[i].row == row) {
+            lighting->lights[i] = lighting->lights[--lighting->light_count];
+            return;
+        }
+    }
+    if (lighting->light_count < MAX_LIGHTS) {
+        lighting->lights[lighting->light_count++] = (Light){col, row};
+    }
+}
+
+void Lighting_update(Lighting *lighting, const Stage *stage, Camera camera, Player player) {
+    i64 origin_col = floor_div(camera.x, TILE_SIZE);
+    i64 origin_row = floor_div(camera.y, TILE_SIZE);
+    i64 player_col = floor_div((i64)player.x + PLAYER_SIZE / 2, TILE_SIZE);
+    i64 player_row = floor_div((i64)player.y + PLAYER_SIZE / 2, TILE_SIZE);
+    bool unchanged = !lighting->dirty
+        && origin_col == lighting->origin_col
+        && origin_row == lighting->origin_row
+        && player.show == lighting->player_shown
+        && (!player.show || (player_col == lighting->player_col && player_row == lighting->player_row));
+    if (unchanged) {
+        return;
+    }
+    u64 start = SDL_GetPerformanceCounter();
+    lighting->origin_col = origin_col;
+    lighting->origin_row = origin_row;
+    lighting->player_col = player_col;
+    lighting->player_row = player_row;
+    lighting->player_shown = player.show;
+
+    memset(lighting->levels, 0, sizeof(u8) * lighting->width * lighting->height);
+    if (player.show) {
+        Lighting_cast(lighting, stage, player_col, player_row);
+    }
+    for (size_t i = 0; i < lighting->light_count; i++) {
+        Lighting_cast(lighting, stage, lighting->lights[i].col, lighting->lights[i].row);
+    }
+    for (u64 i = 0; i < lighting->width * lighting->height; i++) {
+        // black, more transparent the more light there is
+        lighting->pixels[i] = AMBIENT_DARKNESS * (255 - lighting->levels[i]) / 255;
+    }
+    SDL_UpdateTexture(lighting->texture, NULL, lighting->pixels, sizeof(u32) * lighting->width);
+    lighting->dirty = false;
+    lighting->last_update_ms =
+        (SDL_GetPerformanceCounter() - start) * 1000. / SDL_GetPerformanceFrequency();
+}
+
+void Lighting_draw(const Lighting *lighting, SDL_ScaledRenderer scaled_renderer, Camera camera) {
+    SDL_Rect dst = {
+        lighting->origin_col * TILE_SIZE - camera.x,
+        lighting->origin_row * TILE_SIZE - camera.y,
+        lighting->width * TILE_SIZE,
+        lighting->height * TILE_SIZE
+    };
+    SDL_ScaledRenderCopy(scaled_renderer, lighting->texture, NULL, &dst);
+}
@@ -0,0 +1,47 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <stdbool.h>
+#include <SDL.h>
+#include "SDL_utils.h"
+#include "stage.h"
+#include "types.h"
+
+// How far (in tiles) the player and the light sources shine, at most 31.
+#define LIGHT_RADIUS 20
+#define MAX_LIGHTS 64
+
+typedef struct {
+    i64 col, row;
+} Light;
+
+/**
+ * Darkness overlay computed with shadowcasting from the player and the
+ * placed light sources. Only the tiles on the screen are lit, so the cost does
+ * not depend on the stage size, and the result is cached until the player
+ * moves to another tile, the camera scrolls to another tile, the lights change
+ * or `Lighting_invalidate` is called.
+ */
+typedef struct {
+    SDL_Texture *texture;  // one pixel per tile of the window
+    u32 *pixels;
+    u8 *levels;            // light level of every tile of the window
+    u64 width, height;     // window size in tiles
+    i64 origin_col, origin_row;  // top left tile of the window
+    i64 player_col, player_row;
+    bool player_shown;
+    Light lights[MAX_LIGHTS];
+    size_t light_count;
+    bool dirty;
+    f64 last_update_ms;
+} Lighting;
+
+void Lighting_init(Lighting *lighting, SDL_Renderer *renderer);
+void Lighting_destroy(Lighting *lighting);
+void Lighting_invalidate(Lighting *lighting);
+void Lighting_clear_lights(Lighting *lighting);
+void Lighting_toggle_light(Lighting *lighting, i64 col, i64 row);
+void Lighting_update(Lighting *lighting, const Stage *stage, Camera camera, Player player);
+void Lighting_draw(const Lighting *lighting, SDL_ScaledRenderer scaled_renderer, Camera camera);
+
+#endif // LIGHTING_H
@@ -0,0 +1,579 @@
+#include <SDL.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "live.h"
+
+/**
+ * Messages are a type byte and a u32 payload size followed by the payload.
+ *
+ *     EDIT      u32 seq, u32 run count, runs
+ *     ACK       u32 seq
+ *     SNAPSHOT  u64 width, u64 height, u32 run count, runs of solid tiles
+ *
+ * A run is three varints: the row and the column as zigzag deltas to the
+ * previous run, and the length shifted left by one with the tile value in
+ * the lowest bit. Edits from the authority itself have seq 0 and are not
+ * acknowledged.
+ */
+#define MSG_EDIT 1
+#define MSG_ACK 2
+#define MSG_SNAPSHOT 3
+#define HEADER_SIZE (1 + sizeof(u32))
+#define MAX_VARINT_SIZE 10
+
+static f64 ms_since(u64 start) {
+    return (SDL_GetPerformanceCounter() - start) * 1000. / SDL_GetPerformanceFrequency();
+}
+
+// RunList
+
+static void RunList_push(RunList *list, TileRun run) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? 2 * list->capacity : 64;
+        list->runs = realloc(list->runs, sizeof(TileRun) * list->capacity);
+    }
+    list->runs[list->count++] = run;
+}
+
+static void RunList_destroy(RunList *list) {
+    free(list->runs);
+    *list = (RunList){NULL, 0, 0};
+}
+
+/**
+ * Append the runs of equal tiles of a rectangle inside of the stage, only the
+ * solid ones when `solid_only`.
+ */
+static void RunList_collect(
+    RunList *list, const Stage *stage, i64 col, i64 row, u64 width, u64 height, bool solid_only
+) {
+    for (i64 r = row; r < row + (i64)height; r++) {
+        i64 c = col, end = col + width;
+        while (c < end) {
+            bool value = Stage_get_tile(stage, c, r);
+            i64 start = c;
+            while (c < end) {
+                u64 count = end - c < 64 ? end - c : 64;
+                u64 bits = Stage_read_tiles(stage, r, c, count);
+                u64 different = (value ? ~bits : bits) & (count == 64 ? ~(u64)0 : ((u64)1 << count) - 1);
+                if (different) {
+                    c += __builtin_ctzll(different);
+                    break;
+                }
+                c += count;
+            }
+            if (value || !solid_only) {
+                RunList_push(list, (TileRun){r, start, c - start, value});
+            }
+        }
+    }
+}
+
+// ByteBuffer
+
+static void ByteBuffer_reserve(ByteBuffer *buffer, size_t size) {
+    if (buffer->size + size <= buffer->capacity) { return; }
+    while (buffer->size + size > buffer->capacity) {
+        buffer->capacity = buffer->capacity ? 2 * buffer->capacity : 4096;
+    }
+    buffer->data = realloc(buffer->data, buffer->capacity);
+}
+
+static void ByteBuffer_append(ByteBuffer *buffer, const void *data, size_t size) {
+    ByteBuffer_reserve(buffer, size);
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void ByteBuffer_consume(ByteBuffer *buffer, size_t size) {
+    memmove(buffer->data, buffer->data + size, buffer->size - size);
+    buffer->size -= size;
+}
+
+static void ByteBuffer_destroy(ByteBuffer *buffer) {
+    free(buffer->data);
+    *buffer = (ByteBuffer){NULL, 0, 0};
+}
+
+static void put_varint(ByteBuffer *buffer, u64 value) {
+    u8 bytes[MAX_VARINT_SIZE];
+    size_t size = 0;
+    do {
+        bytes[size] = value & 0x7f;
+        value >>= 7;
+        bytes[size++] |= value ? 0x80 : 0;
+    } while (value);
+    ByteBuffer_append(buffer, bytes, size);
+}
+
+static inline u64 zigzag(i64 value) {
+    return ((u64)value << 1) ^ (u64)(value >> 63);
+}
+
+static inline i64 unzigzag(u64 value) {
+    return (i64)(value >> 1) ^ -(i64)(value & 1);
+}
+
+typedef struct {
+    const u8 *data;
+    size_t size, position;
+    bool failed;
+} Reader;
+
+static void Reader_read(Reader *reader, void *dst, size_t size) {
+    if (reader->failed || reader->position + size > reader->size) {
+        reader->failed = true;
+        memset(dst, 0, size);
+        return;
+    }
+    memcpy(dst, reader->data + reader->position, size);
+    reader->position += size;
+}
+
+static u64 Reader_varint(Reader *reader) {
+    u64 value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        u8 byte;
+        Reader_read(reader, &byte, 1);
+        value |= (u64)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) { return value; }
+    }
+    reader->failed = true;
+    return 0;
+}
+
+static void put_runs(ByteBuffer *buffer, const RunList *list) {
+    u32 count = list->count;
+    ByteBuffer_append(buffer, &count, sizeof(count));
+    i64 prev_row = 0, prev_col = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        const TileRun *run = &list->runs[i];
+        put_varint(buffer, zigzag(run->row - prev_row));
+        put_varint(buffer, zigzag(run->col - prev_col));
+        put_varint(buffer, run->length << 1 | run->value);
+        prev_row = run->row;
+        prev_col = run->col;
+    }
+}
+
+static bool read_runs(Reader *reader, RunList *list) {
+    u32 count;
+    Reader_read(reader, &count, sizeof(count));
+    i64 prev_row = 0, prev_col = 0;
+    for (u32 i = 0; i < count && !reader->failed; i++) {
+        TileRun run;
+        run.row = prev_row + unzigzag(Reader_varint(reader));
+        run.col = prev_col + unzigzag(Reader_varint(reader));
+        u64 length = Reader_varint(reader);
+        run.length = length >> 1;
+        run.value = length & 1;
+        RunList_push(list, run);
+        prev_row = run.row;
+        prev_col = run.col;
+    }
+    return !reader->failed;
+}
+
+/**
+ * Start a message in `buffer`, returns where its size has to be patched.
+ */
+static size_t begin_message(ByteBuffer *buffer, u8 type) {
+    ByteBuffer_append(buffer, &type, 1);
+    size_t size_position = buffer->size;
+    u32 size = 0;
+    ByteBuffer_append(buffer, &size, sizeof(size));
+    return size_position;
+}
+
+static void end_message(ByteBuffer *buffer, size_t size_position) {
+    u32 size = buffer->size - size_position - sizeof(u32);
+    memcpy(buffer->data + size_position, &size, sizeof(size));
+}
+
+static void put_edit(ByteBuffer *buffer, u32 seq, const RunList *runs) {
+    size_t size_position = begin_message(buffer, MSG_EDIT);
+    ByteBuffer_append(buffer, &seq, sizeof(seq));
+    put_runs(buffer, runs);
+    end_message(buffer, size_position);
+}
+
+// Stage
+
+static void include_row(LiveChanges *changes, i64 row) {
+    if (changes->first_row > changes->last_row) {
+        changes->first_row = changes->last_row = row;
+        return;
+    }
+    if (row < changes->first_row) { changes->first_row = row; }
+    if (row > changes->last_row) { changes->last_row = row; }
+}
+
+static void apply_runs(Stage *stage, const RunList *list, LiveChanges *changes) {
+    for (size_t i = 0; i < list->count; i++) {
+        const TileRun *run = &list->runs[i];
+        if (Stage_fill_tiles(stage, run->row, run->col, run->length, run->value)) {
+            include_row(changes, run->row);
+        }
+    }
+}
+
+/**
+ * Apply the local edits the authority has not acknowledged yet again, they
+ * come after everything it has sent so far.
+ */
+static void replay_local_edits(Live *live, Stage *stage, LiveChanges *changes) {
+    for (size_t i = 0; i < live->pending_count; i++) {
+        apply_runs(stage, &live->pending[i].runs, changes);
+    }
+    apply_runs(stage, &live->batch, changes);
+}
+
+// Connections
+
+static void set_non_blocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+static void Live_add_connection(Live *live, int fd) {
+    set_non_blocking(fd);
+    live->connections[live->connection_count++] = (LiveConnection){
+        .fd = fd,
+        .in = {NULL, 0, 0},
+        .out = {NULL, 0, 0}
+    };
+}
+
+static void Live_remove_connection(Live *live, size_t index) {
+    LiveConnection *connection = &live->connections[index];
+    close(connection->fd);
+    ByteBuffer_destroy(&connection->in);
+    ByteBuffer_destroy(&connection->out);
+    live->connections[index] = live->connections[--live->connection_count];
+}
+
+/**
+ * Send as much of the queued output as the socket takes without blocking.
+ */
+static bool LiveConnection_send(Live *live, LiveConnection *connection) {
+    size_t sent = 0;
+    while (sent < connection->out.size) {
+        ssize_t n = send(connection->fd, connection->out.data + sent, connection->out.size - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { break; }
+            return false;
+        }
+        sent += n;
+    }
+    live->bytes_sent += sent;
+    ByteBuffer_consume(&connection->out, sent);
+    return true;
+}
+
+static bool LiveConnection_receive(Live *live, LiveConnection *connection) {
+    while (true) {
+        ByteBuffer_reserve(&connection->in, 4096);
+        ssize_t n = recv(
+            connection->fd,
+            connection->in.data + connection->in.size,
+            connection->in.capacity - connection->in.size,
+            0
+        );
+        if (n == 0) { return false; }
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection->in.size += n;
+        live->bytes_received += n;
+    }
+}
+
+// Live
+
+void Live_init(Live *live) {
+    memset(live, 0, sizeof(Live));
+    live->role = LIVE_OFF;
+    live->listen_fd = -1;
+    live->next_seq = 1;
+}
+
+/**
+ * Join the session of the stage, or start it when there is none. Returns
+ * false when neither worked.
+ */
+bool Live_start(Live *live, const char *stage_name) {
+    Live_stop(live);
+    // one socket per stage file
+    snprintf(live->path, sizeof(live->path), "/tmp/platformer-%s", stage_name);
+    for (char *c = live->path + strlen("/tmp/"); *c; c++) {
+        if (*c == '/') { *c = '_'; }
+    }
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    memcpy(address.sun_path, live->path, sizeof(address.sun_path));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { return false; }
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        live->role = LIVE_CLIENT;
+        Live_add_connection(live, fd);
+        printf("Joined the live session %s\n", live->path);
+        return true;
+    }
+    // nobody is listening, the socket file may be left over from a crash
+    unlink(live->path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, LIVE_MAX_CLIENTS) != 0) {
+        printf("Failed to start the live session %s: %s\n", live->path, strerror(errno));
+        close(fd);
+        return false;
+    }
+    set_non_blocking(fd);
+    live->role = LIVE_AUTHORITY;
+    live->listen_fd = fd;
+    printf("Started the live session %s\n", live->path);
+    return true;
+}
+
+void Live_stop(Live *live) {
+    while (live->connection_count > 0) {
+        Live_remove_connection(live, live->connection_count - 1);
+    }
+    if (live->listen_fd >= 0) {
+        close(live->listen_fd);
+        unlink(live->path);
+        live->listen_fd = -1;
+    }
+    for (size_t i = 0; i < live->pending_count; i++) {
+        RunList_destroy(&live->pending[i].runs);
+    }
+    free(live->pending);
+    live->pending = NULL;
+    live->pending_count = live->pending_capacity = 0;
+    RunList_destroy(&live->batch);
+    live->role = LIVE_OFF;
+}
+
+/**
+ * Record a tile changed by this editor.
+ */
+void Live_record(Live *live, i64 col, i64 row, bool value) {
+    if (live->role == LIVE_OFF) { return; }
+    if (live->batch.count > 0) {
+        // extend the last run when painting along a row
+        TileRun *last = &live->batch.runs[live->batch.count - 1];
+        if (last->row == row && last->value == value && last->col + (i64)last->length == col) {
+            last->length++;
+            return;
+        }
+    }
+    RunList_push(&live->batch, (TileRun){row, col, 1, value});
+}
+
+/**
+ * Record a rectangle of tiles changed by this editor, e.g. by a paste.
+ */
+void Live_record_rect(Live *live, const Stage *stage, i64 col, i64 row, u64 width, u64 height) {
+    if (live->role == LIVE_OFF) { return; }
+    if (col < 0) { width = (i64)width + col > 0 ? width + col : 0; col = 0; }
+    if (row < 0) { height = (i64)height + row > 0 ? height + row : 0; row = 0; }
+    if (col + width > stage->width) { width = (u64)col < stage->width ? stage->width - col : 0; }
+    if (row + height > stage->height) { height = (u64)row < stage->height ? stage->height - row : 0; }
+    RunList_collect(&live->batch, stage, col, row, width, height, false);
+}
+
+/**
+ * Queue the edits recorded so far as one message. They are already applied to
+ * the local stage, so this has to happen before applying anything received,
+ * or the authority would forward them in another order than it applied them
+ * and a client would lose them when replaying its pending edits.
+ */
+static void Live_queue_batch(Live *live) {
+    if (live->batch.count > 0) {
+        live->batches_sent++;
+        live->runs_sent += live->batch.count;
+        if (live->role == LIVE_AUTHORITY) {
+            for (size_t i = 0; i < live->connection_count; i++) {
+                put_edit(&live->connections[i].out, 0, &live->batch);
+            }
+            live->batch.count = 0;
+        } else {
+            put_edit(&live->connections[0].out, live->next_seq, &live->batch);
+            if (live->pending_count == live->pending_capacity) {
+                live->pending_capacity = live->pending_capacity ? 2 * live->pending_capacity : 16;
+                live->pending = realloc(live->pending, sizeof(PendingBatch) * live->pending_capacity);
+            }
+            live->pending[live->pending_count++] = (PendingBatch){
+                .seq = live->next_seq++,
+                .sent_at = SDL_GetPerformanceCounter(),
+                .runs = live->batch
+            };
+            live->batch = (RunList){NULL, 0, 0};
+        }
+    }
+}
+
+/**
+ * Send the edits of the frame as one message, and whatever else is queued.
+ */
+void Live_flush(Live *live) {
+    if (live->role == LIVE_OFF) { return; }
+    Live_queue_batch(live);
+    for (size_t i = 0; i < live->connection_count;) {
+        if (!LiveConnection_send(live, &live->connections[i])) {
+            Live_remove_connection(live, i);
+            continue;
+        }
+        i++;
+    }
+}
+
+static void Live_accept(Live *live, const Stage *stage) {
+    int fd;
+    while ((fd = accept(live->listen_fd, NULL, NULL)) >= 0) {
+        if (live->connection_count == LIVE_MAX_CLIENTS) {
+            close(fd);
+            continue;
+        }
+        Live_add_connection(live, fd);
+        u64 start = SDL_GetPerformanceCounter();
+        RunList runs = {NULL, 0, 0};
+        RunList_collect(&runs, stage, 0, 0, stage->width, stage->height, true);
+        ByteBuffer *out = &live->connections[live->connection_count - 1].out;
+        size_t size_position = begin_message(out, MSG_SNAPSHOT);
+        ByteBuffer_append(out, &stage->width, sizeof(stage->width));
+        ByteBuffer_append(out, &stage->height, sizeof(stage->height));
+        put_runs(out, &runs);
+        end_message(out, size_position);
+        printf(
+            "Client joined, snapshot of %zu runs (%.1f KB) in %.2f ms\n",
+            runs.count, (out->size - size_position) / 1024., ms_since(start)
+        );
+        RunList_destroy(&runs);
+    }
+}
+
+/**
+ * Handle one message, returns false if it is malformed.
+ */
+static bool Live_handle(Live *live, size_t from, u8 type, Reader *reader, Stage *stage, LiveChanges *changes) {
+    RunList runs = {NULL, 0, 0};
+    bool ok = true;
+    switch (type) {
+    case MSG_EDIT: {
+        u32 seq;
+        Reader_read(reader, &seq, sizeof(seq));
+        if (!(ok = read_runs(reader, &runs))) { break; }
+        apply_runs(stage, &runs, changes);
+        if (live->role == LIVE_AUTHORITY) {
+            for (size_t i = 0; i < live->connection_count; i++) {
+                if (i != from) {
+                    put_edit(&live->connections[i].out, 0, &runs);
+                }
+            }
+            ByteBuffer *out = &live->connections[from].out;
+            size_t size_position = begin_message(out, MSG_ACK);
+            ByteBuffer_append(out, &seq, sizeof(seq));
+            end_message(out, size_position);
+        } else {
+            replay_local_edits(live, stage, changes);
+        }
+        break;
+    }
+    case MSG_ACK: {
+        u32 seq;
+        Reader_read(reader, &seq, sizeof(seq));
+        if (reader->failed || live->pending_count == 0 || live->pending[0].seq != seq) {
+            ok = false;
+            break;
+        }
+        live->acked++;
+        live->ack_time += SDL_GetPerformanceCounter() - live->pending[0].sent_at;
+        RunList_destroy(&live->pending[0].runs);
+        memmove(live->pending, live->pending + 1, sizeof(PendingBatch) * --live->pending_count);
+        break;
+    }
+    case MSG_SNAPSHOT: {
+        u64 width, height;
+        Reader_read(reader, &width, sizeof(width));
+        Reader_read(reader, &height, sizeof(height));
+        if (!(ok = read_runs(reader, &runs)) || width == 0 || height == 0) {
+            ok = false;
+            break;
+        }
+        if (width != stage->width || height != stage->height) {
+            Stage_destroy(stage);
+            Stage_alloc(stage, width, height);
+            changes->resized = true;
+        } else {
+            for (u64 row = 0; row < height; row++) {
+                Stage_fill_tiles(stage, row, 0, width, false);
+            }
+        }
+        apply_runs(stage, &runs, changes);
+        replay_local_edits(live, stage, changes);
+        changes->first_row = 0;
+        changes->last_row = height - 1;
+        break;
+    }
+    default:
+        ok = false;
+        break;
+    }
+    RunList_destroy(&runs);
+    return ok && !reader->failed;
+}
+
+/**
+ * Queue the local edits, accept clients and apply the edits received since
+ * the last call.
+ */
+LiveChanges Live_poll(Live *live, Stage *stage) {
+    LiveChanges changes = {.first_row = 1, .last_row = 0, .resized = false};
+    if (live->role == LIVE_OFF) { return changes; }
+    Live_queue_batch(live);
+    if (live->role == LIVE_AUTHORITY) {
+        Live_accept(live, stage);
+    }
+    for (size_t i = 0; i < live->connection_count;) {
+        LiveConnection *connection = &live->connections[i];
+        bool ok = LiveConnection_receive(live, connection);
+        size_t position = 0;
+        while (ok && connection->in.size - position >= HEADER_SIZE) {
+            u8 type = connection->in.data[position];
+            u32 size;
+            memcpy(&size, connection->in.data + position + 1, sizeof(size));
+            if (connection->in.size - position - HEADER_SIZE < size) { break; }
+            Reader reader = {connection->in.data + position + HEADER_SIZE, size, 0, false};
+            ok = Live_handle(live, i, type, &reader, stage, &changes);
+            position += HEADER_SIZE + size;
+        }
+        if (!ok) {
+            if (live->role == LIVE_CLIENT) {
+                printf("Left the live session %s\n", live->path);
+                Live_stop(live);
+                return changes;
+            }
+            printf("Client left\n");
+            Live_remove_connection(live, i);
+            continue;
+        }
+        ByteBuffer_consume(&connection->in, position);
+        i++;
+    }
+    return changes;
+}
+
+void Live_print_stats(const Live *live) {
+    printf(
+        "Live: sent %lu batches of %lu runs (%.1f KB), received %.1f KB, "
+        "average ack after %.2f ms\n",
+        live->batches_sent,
+        live->runs_sent,
+        live->bytes_sent / 1024.,
+        live->bytes_received / 1024.,
+        live->acked ? live->ack_time * 1000. / SDL_GetPerformanceFrequency() / live->acked : 0.
+    );
+}
@@ -0,0 +1,92 @@
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/un.h>
+#include "stage.h"
+#include "types.h"
+
+#define LIVE_MAX_CLIENTS 16
+
+typedef struct {
+    i64 row, col;
+    u64 length;
+    bool value;
+} TileRun;
+
+typedef struct {
+    TileRun *runs;
+    size_t count, capacity;
+} RunList;
+
+typedef struct {
+    u8 *data;
+    size_t size, capacity;
+} ByteBuffer;
+
+typedef struct {
+    int fd;
+    ByteBuffer in, out;
+} LiveConnection;
+
+typedef struct {
+    u32 seq;
+    u64 sent_at;
+    RunList runs;
+} PendingBatch;
+
+typedef enum {
+    LIVE_OFF,
+    LIVE_AUTHORITY,
+    LIVE_CLIENT,
+} LiveRole;
+
+/**
+ * Several editors working on the same stage through a Unix socket. The first
+ * editor to open the session is the authority: it keeps the reference stage,
+ * sends it to every client that connects, applies the edits in the order they
+ * arrive and forwards them to the other clients.
+ *
+ * Edits made during a frame are collected as runs of equal tiles and queued
+ * as a single message before the edits received from the others are applied,
+ * so that everyone sees them in the order the authority applied them. Clients
+ * apply their own edits right away and keep them until the authority
+ * acknowledges them, replaying them on top of every edit that the authority
+ * ordered before them.
+ */
+typedef struct {
+    LiveRole role;
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    int listen_fd;
+    // the clients for the authority, the authority for a client
+    LiveConnection connections[LIVE_MAX_CLIENTS];
+    size_t connection_count;
+    RunList batch;  // edits of the current frame
+    PendingBatch *pending;
+    size_t pending_count, pending_capacity;
+    u32 next_seq;
+    // traffic
+    u64 bytes_sent, bytes_received;
+    u64 batches_sent, runs_sent;
+    u64 acked, ack_time;  // ack_time in performance counter units
+} Live;
+
+/**
+ * What `Live_poll` changed in the stage.
+ */
+typedef struct {
+    i64 first_row, last_row;  // first > last when nothing changed
+    bool resized;             // the stage was reallocated with another size
+} LiveChanges;
+
+void Live_init(Live *live);
+bool Live_start(Live *live, const char *stage_name);
+void Live_stop(Live *live);
+void Live_record(Live *live, i64 col, i64 row, bool value);
+void Live_record_rect(Live *live, const Stage *stage, i64 col, i64 row, u64 width, u64 height);
+void Live_flush(Live *live);
+LiveChanges Live_poll(Live *live, Stage *stage);
+void Live_print_stats(const Live *live);
+
+#endif // LIVE_H
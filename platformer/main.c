@@ -5,9 +5,16 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <math.h>
-#include <dirent.h>
+#include <string.h>
 
 #include "SDL_utils.h"
+#include "generator.h"
+#include "lighting.h"
+#include "live.h"
+#include "minimap.h"
+#include "playlist.h"
+#include "pyramid.h"
+#include "rewind.h"
 #include "stage.h"
 #include "types.h"
 #include "input_state.h"
@@ -18,21 +25,58 @@
 #define TILE_SIZE 40
 #define MIN_LEVEL_WIDTH 32  // 1280 / 40
 #define MIN_LEVEL_HEIGHT 18 // 720 / 40
+#define MAX_ZOOM 16
+#define REWIND_CAPACITY (4 << 20)
+// the physics run in steps of a fixed number of ticks (ms), whatever the frame
+// rate, and the player is drawn between the last two steps
+#define PHYSICS_STEP_TICKS 16
+// time not simulated yet is dropped past this, after a long frame
+#define MAX_PHYSICS_LAG_TICKS 250
+
+static inline i64 floor_div(i64 a, i64 b) {
+    i64 q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
 
 typedef struct {
     Window window;
-    char *stage_name;
+    Playlist *playlist;
+    const char *stage_name;
     Stage *stage;
     Player player;
+    Player previous_player;  // before the last physics step
+    u64 physics_lag;         // time not simulated yet, in performance counter units
+    Rewind rewind;
+    Camera camera;
+    SDL_Texture *tile_atlas;
+    Minimap minimap;
+    bool dragging_minimap;
+    Pyramid pyramid;
+    Lighting lighting;
+    bool show_lighting;
     bool show_grid;
+    SDL_Rect selection;  // in tiles, empty when w == 0
+    TileRegion clipboard;
+    Live live;
 } App;
 
-App App_new() {
+App App_new(Playlist *playlist) {
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_init(&window, &renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
     f32 xs, ys;
     SDL_get_window_scale(window, renderer, &xs, &ys);
+    Stage *stage = Playlist_current(playlist);
+    Minimap minimap;
+    Minimap_init(&minimap, renderer, stage);
+    Pyramid pyramid;
+    Pyramid_init(&pyramid, renderer, stage);
+    Lighting lighting;
+    Lighting_init(&lighting, renderer);
+    Rewind rewind;
+    Rewind_init(&rewind, REWIND_CAPACITY, PHYSICS_STEP_TICKS);
+    Live live;
+    Live_init(&live);
     return (App){
         .window = {
             .scaled_renderer = {
@@ -51,24 +95,290 @@ App App_new() {
             .dy = 0,
             .show = false
         },
-        .stage_name = NULL,
-        .stage = NULL,
-        .show_grid = false
+        .previous_player = {0, 0, 0, 0, false},
+        .physics_lag = 0,
+        .playlist = playlist,
+        .rewind = rewind,
+        .stage_name = Playlist_current_name(playlist),
+        .stage = stage,
+        .camera = {0, 0, 0},
+        .tile_atlas = TileAtlas_create(renderer),
+        .minimap = minimap,
+        .dragging_minimap = false,
+        .pyramid = pyramid,
+        .lighting = lighting,
+        .show_lighting = false,
+        .show_grid = false,
+        .selection = {0, 0, 0, 0},
+        .clipboard = {0, 0, 0, NULL},
+        .live = live
     };
 }
 
 void App_destroy(App app) {
+    Minimap_destroy(&app.minimap);
+    Pyramid_destroy(&app.pyramid);
+    Lighting_destroy(&app.lighting);
+    Rewind_destroy(&app.rewind);
+    Live_stop(&app.live);
+    SDL_DestroyTexture(app.tile_atlas);
     SDL_destroy(&app.window.window, &app.window.scaled_renderer.renderer);
-    if (app.stage != NULL) {
-        Stage_destroy(app.stage);
-        free(app.stage);
+    TileRegion_destroy(&app.clipboard);
+}
+
+/**
+ * Mark tile rows from `first_row` to `last_row` as modified, the rows may
+ * extend past the stage.
+ */
+void App_mark_modified(App *app, i64 first_row, i64 last_row) {
+    if (first_row < 0) { first_row = 0; }
+    if (last_row >= (i64)app->stage->height) { last_row = app->stage->height - 1; }
+    if (first_row > last_row) { return; }
+    Playlist_set_modified(app->playlist, true);
+    Minimap_mark_dirty(&app->minimap, first_row, last_row);
+    Pyramid_mark_dirty(&app->pyramid, first_row, last_row);
+    Lighting_invalidate(&app->lighting);
+}
+
+/**
+ * Translate a point on the screen into stage pixels.
+ */
+void App_to_stage(App *app, i32 x, i32 y, i32 *stage_x, i32 *stage_y) {
+    *stage_x = app->camera.x + x * (1 << app->camera.zoom);
+    *stage_y = app->camera.y + y * (1 << app->camera.zoom);
+}
+
+/**
+ * Get the tile under a point on the screen.
+ */
+bool App_tile_at(App *app, i32 x, i32 y) {
+    i32 stage_x, stage_y;
+    App_to_stage(app, x, y, &stage_x, &stage_y);
+    return Stage_tile_at(app->stage, stage_x, stage_y);
+}
+
+void App_screen_to_tile(App *app, i32 x, i32 y, i64 *col, i64 *row) {
+    i32 stage_x, stage_y;
+    App_to_stage(app, x, y, &stage_x, &stage_y);
+    // round down, also left of and above the stage
+    *col = floor_div(stage_x, TILE_SIZE);
+    *row = floor_div(stage_y, TILE_SIZE);
+}
+
+/**
+ * Set a tile and share the edit with the live session. Returns false if the
+ * tile is outside of the stage.
+ */
+bool App_set_tile(App *app, i64 col, i64 row, bool value) {
+    bool old = Stage_get_tile(app->stage, col, row);
+    if (!Stage_set_tile(app->stage, col, row, value)) {
+        return false;
+    }
+    if (old != value) {
+        App_mark_modified(app, row, row);
+        Live_record(&app->live, col, row, value);
+    }
+    return true;
+}
+
+/**
+ * Set the tile under a point on the screen. Returns false if the point is
+ * outside of the stage.
+ */
+bool App_set_tile_at(App *app, i32 x, i32 y, bool value) {
+    i64 col, row;
+    App_screen_to_tile(app, x, y, &col, &row);
+    return App_set_tile(app, col, row, value);
+}
+
+/**
+ * Set every tile on the line between two points on the screen, so that fast
+ * mouse drags leave no gaps.
+ */
+void App_paint_line(App *app, i32 x0, i32 y0, i32 x1, i32 y1, bool value) {
+    i64 col, row, end_col, end_row;
+    App_screen_to_tile(app, x0, y0, &col, &row);
+    App_screen_to_tile(app, x1, y1, &end_col, &end_row);
+    i64 dx = end_col > col ? end_col - col : col - end_col;
+    i64 dy = end_row > row ? end_row - row : row - end_row;
+    i64 step_col = col < end_col ? 1 : -1, step_row = row < end_row ? 1 : -1;
+    i64 error = dx - dy;
+    while (true) {
+        App_set_tile(app, col, row, value);
+        if (col == end_col && row == end_row) { break; }
+        if (2 * error > -dy) { error -= dy; col += step_col; }
+        if (2 * error < dx) { error += dx; row += step_row; }
+    }
+}
+
+/**
+ * Center the screen on a point given in stage pixels.
+ */
+void App_center_camera(App *app, i32 x, i32 y) {
+    app->camera.x = x - (SCREEN_WIDTH << app->camera.zoom) / 2;
+    app->camera.y = y - (SCREEN_HEIGHT << app->camera.zoom) / 2;
+}
+
+/**
+ * Zoom in (or out) by `steps` powers of two, keeping the stage point under
+ * the screen point (x, y) in place.
+ */
+void App_zoom(App *app, i32 steps, i32 x, i32 y) {
+    i32 zoom = (i32)app->camera.zoom + steps;
+    if (zoom < 0) { zoom = 0; }
+    if (zoom > MAX_ZOOM) { zoom = MAX_ZOOM; }
+    i32 stage_x, stage_y;
+    App_to_stage(app, x, y, &stage_x, &stage_y);
+    app->camera.zoom = zoom;
+    app->camera.x = stage_x - x * (1 << zoom);
+    app->camera.y = stage_y - y * (1 << zoom);
+}
+
+/**
+ * The player as drawn in this frame, part of the way from the previous physics
+ * step to the last one.
+ */
+Player App_drawn_player(const App *app) {
+    u64 step = SDL_GetPerformanceFrequency() * PHYSICS_STEP_TICKS / 1000;
+    return Player_interpolate(app->previous_player, app->player, (f32)app->physics_lag / step);
+}
+
+/**
+ * Run the physics steps due since the last frame.
+ */
+void App_step_physics(App *app, u64 elapsed, InputState input_state) {
+    u64 step = SDL_GetPerformanceFrequency() * PHYSICS_STEP_TICKS / 1000;
+    u64 max_lag = SDL_GetPerformanceFrequency() * MAX_PHYSICS_LAG_TICKS / 1000;
+    app->physics_lag += elapsed;
+    if (app->physics_lag > max_lag) {
+        app->physics_lag = max_lag;
+    }
+    for (; app->physics_lag >= step; app->physics_lag -= step) {
+        app->previous_player = app->player;
+        if (input_state.rewind_down) {
+            // back in time as fast as it went forward
+            Rewind_pop(&app->rewind, &app->player);
+        } else if (app->player.show) {
+            Player_update(&app->player, app->stage, PHYSICS_STEP_TICKS, input_state);
+            Rewind_record(&app->rewind, app->player);
+        }
+    }
+}
+
+/**
+ * Keep the player away from the screen edges and the camera within the stage.
+ */
+void App_update_camera(App *app) {
+    // size of the visible part of the stage
+    i32 view_w = SCREEN_WIDTH << app->camera.zoom, view_h = SCREEN_HEIGHT << app->camera.zoom;
+    Player player = App_drawn_player(app);
+    if (player.show) {
+        i32 margin_x = view_w / 4, margin_y = view_h / 4;
+        i32 x = player.x, y = player.y;
+        if (x < app->camera.x + margin_x) { app->camera.x = x - margin_x; }
+        if (x + PLAYER_SIZE > app->camera.x + view_w - margin_x) {
+            app->camera.x = x + PLAYER_SIZE - view_w + margin_x;
+        }
+        if (y < app->camera.y + margin_y) { app->camera.y = y - margin_y; }
+        if (y + PLAYER_SIZE > app->camera.y + view_h - margin_y) {
+            app->camera.y = y + PLAYER_SIZE - view_h + margin_y;
+        }
+    }
+    i32 max_x = (i32)(app->stage->width * TILE_SIZE) - view_w;
+    i32 max_y = (i32)(app->stage->height * TILE_SIZE) - view_h;
+    if (app->camera.x > max_x) { app->camera.x = max_x; }
+    if (app->camera.y > max_y) { app->camera.y = max_y; }
+    if (app->camera.x < 0) { app->camera.x = 0; }
+    if (app->camera.y < 0) { app->camera.y = 0; }
+}
+
+/**
+ * Select the rectangle of tiles spanned by two corner tiles.
+ */
+void App_select(App *app, i64 col0, i64 row0, i64 col1, i64 row1) {
+    app->selection = (SDL_Rect){
+        .x = col0 < col1 ? col0 : col1,
+        .y = row0 < row1 ? row0 : row1,
+        .w = (col0 < col1 ? col1 - col0 : col0 - col1) + 1,
+        .h = (row0 < row1 ? row1 - row0 : row0 - row1) + 1
+    };
+}
+
+void App_copy_selection(App *app) {
+    if (app->selection.w == 0) { return; }
+    Stage_copy_region(
+        app->stage,
+        app->selection.x, app->selection.y, app->selection.w, app->selection.h,
+        &app->clipboard
+    );
+    printf("Copied %lux%lu tiles\n", app->clipboard.width, app->clipboard.height);
+}
+
+/**
+ * Paste (or stamp) the clipboard with its top left corner at the tile under
+ * the mouse cursor.
+ */
+void App_paste_clipboard(App *app, BlitMode mode) {
+    if (app->clipboard.bits == NULL) { return; }
+    int x, y;
+    SDL_GetMouseState(&x, &y);
+    i64 col, row;
+    App_screen_to_tile(app, x, y, &col, &row);
+    Stage_blit_region(app->stage, &app->clipboard, col, row, mode);
+    App_mark_modified(app, row, row + app->clipboard.height - 1);
+    Live_record_rect(&app->live, app->stage, col, row, app->clipboard.width, app->clipboard.height);
+}
+
+/**
+ * Rebuild everything derived from the stage after it was replaced.
+ */
+void App_rebuild_views(App *app) {
+    Minimap_destroy(&app->minimap);
+    Minimap_init(&app->minimap, app->window.scaled_renderer.renderer, app->stage);
+    Pyramid_destroy(&app->pyramid);
+    Pyramid_init(&app->pyramid, app->window.scaled_renderer.renderer, app->stage);
+    Lighting_invalidate(&app->lighting);
+}
+
+/**
+ * Switch to the next (or previous) stage of the playlist.
+ */
+void App_switch_stage(App *app, bool next) {
+    u64 start = SDL_GetPerformanceCounter();
+    app->stage = next ? Playlist_next(app->playlist) : Playlist_prev(app->playlist);
+    app->stage_name = Playlist_current_name(app->playlist);
+    app->camera = (Camera){0, 0, app->camera.zoom};
+    App_rebuild_views(app);
+    Lighting_clear_lights(&app->lighting);
+    Rewind_clear(&app->rewind);
+    if (app->live.role != LIVE_OFF) {
+        Live_start(&app->live, app->stage_name);
     }
+    printf(
+        "Switched to %s in %.3f ms\n",
+        app->stage_name,
+        (SDL_GetPerformanceCounter() - start) * 1000. / SDL_GetPerformanceFrequency()
+    );
 }
 
-void App_load_stage(App *app, char *stage_file) {
-    app->stage_name = stage_file;
-    app->stage = malloc(sizeof(Stage));
-    Stage_load(app->stage, app->stage_name);
+/**
+ * Replace the current stage with a generated one of the same size.
+ */
+void App_generate_stage(App *app, u64 seed) {
+    u64 start = SDL_GetPerformanceCounter();
+    u64 width = app->stage->width, height = app->stage->height;
+    Stage_destroy(app->stage);
+    Generator_generate(app->stage, width, height, seed);
+    App_rebuild_views(app);
+    App_mark_modified(app, 0, height - 1);
+    Live_record_rect(&app->live, app->stage, 0, 0, width, height);
+    app->selection.w = 0;
+    printf(
+        "Generated %s with seed %lu in %.3f ms\n",
+        app->stage_name,
+        seed,
+        (SDL_GetPerformanceCounter() - start) * 1000. / SDL_GetPerformanceFrequency()
+    );
 }
 
 void App_show_file_name(App app) {
@@ -92,13 +402,46 @@ void App_show_file_name(App app) {
 }
 
 void App_render(App app) {
+    Player player = App_drawn_player(&app);
     SDL_SetRenderDrawColor(app.window.scaled_renderer.renderer, 128, 128, 128, 255);
     SDL_RenderClear(app.window.scaled_renderer.renderer);
-    Stage_draw(app.stage, app.window.scaled_renderer);
-    if (app.show_grid) {
-        show_grid(app.window.scaled_renderer);
+    if (app.camera.zoom == 0) {
+        Stage_draw(app.stage, app.window.scaled_renderer, app.camera, app.tile_atlas);
+        if (app.show_grid) {
+            show_grid(app.window.scaled_renderer, app.camera);
+        }
+        Player_render(player, app.window.scaled_renderer, app.camera);
+        if (app.show_lighting) {
+            Lighting_draw(&app.lighting, app.window.scaled_renderer, app.camera);
+        }
+    } else {
+        Pyramid_draw(&app.pyramid, app.window.scaled_renderer, app.camera);
+        if (player.show) {
+            // keep the player visible however far out the view is zoomed
+            SDL_Rect marker = {
+                floor_div((i32)player.x - app.camera.x, 1 << app.camera.zoom),
+                floor_div((i32)player.y - app.camera.y, 1 << app.camera.zoom),
+                PLAYER_SIZE >> app.camera.zoom,
+                PLAYER_SIZE >> app.camera.zoom
+            };
+            if (marker.w < 3) { marker.w = marker.h = 3; }
+            SDL_SetRenderDrawColor(app.window.scaled_renderer.renderer, 0, 200, 0, 255);
+            SDL_ScaledRenderFillRect(app.window.scaled_renderer, &marker);
+        }
+    }
+    if (app.selection.w != 0) {
+        SDL_Rect selection = {
+            floor_div(app.selection.x * TILE_SIZE - app.camera.x, 1 << app.camera.zoom),
+            floor_div(app.selection.y * TILE_SIZE - app.camera.y, 1 << app.camera.zoom),
+            (app.selection.w * TILE_SIZE) >> app.camera.zoom,
+            (app.selection.h * TILE_SIZE) >> app.camera.zoom
+        };
+        if (selection.w == 0) { selection.w = 1; }
+        if (selection.h == 0) { selection.h = 1; }
+        SDL_SetRenderDrawColor(app.window.scaled_renderer.renderer, 240, 220, 0, 255);
+        SDL_ScaledRenderDrawRect(app.window.scaled_renderer, &selection);
     }
-    Player_render(app.player, app.window.scaled_renderer);
+    Minimap_draw(&app.minimap, app.window.scaled_renderer, app.camera, player);
     App_show_file_name(app);
     SDL_RenderPresent(app.window.scaled_renderer.renderer);
 }
@@ -106,6 +449,8 @@ void App_render(App app) {
 typedef enum {
     TOOL_PLAYER_PLACER,
     TOOL_TILE_MODIFIER,
+    TOOL_REGION_SELECTOR,
+    TOOL_LIGHT_PLACER,
     TOOL_COUNT,
 } ToolType;
 
@@ -123,75 +468,158 @@ typedef struct {
     ToolType type;
 } PlayerPlacer;
 
+/**
+ * Selects a rectangle of tiles by dragging. The selection can be copied (C)
+ * and then pasted (V) or stamped (B) at the mouse cursor, also onto other
+ * stages of the playlist.
+ */
+typedef struct {
+    ToolType type;
+    i64 anchor_col, anchor_row;
+} RegionSelector;
+
+/**
+ * Places (or removes) a light source on the clicked tile, shown when the
+ * lighting is on (L).
+ */
+typedef struct {
+    ToolType type;
+} LightPlacer;
+
 typedef union {
     ToolType type;
     TileModifier tile_modifier;
     PlayerPlacer player_placer;
+    RegionSelector region_selector;
+    LightPlacer light_placer;
 } Tool;
 
+int main(int argc, char **argv) {
+    // stages given as arguments or every stage from the "stages" directory
+    Playlist playlist;
+    if (argc > 1) {
+        Playlist_init(&playlist, argv + 1, argc - 1);
+    } else {
+        char **file_names;
+        size_t count = Playlist_list_files("stages", &file_names);
+        Playlist_init(&playlist, file_names, count);
+        for (size_t i = 0; i < count; i++) {
+            free(file_names[i]);
+        }
+        free(file_names);
+    }
 
-int main() {
-    struct dirent *entry;
-    DIR *dp = opendir("stages");
-    while((entry = readdir(dp)))
-        puts(entry->d_name);
-    closedir(dp);
-
-    App app = App_new();
-    /* app.stage_name = "stages/test_stage_2.bin"; */
-    /* app.stage = malloc(sizeof(Stage)); */
-    /* Stage_init(app.stage); */
-    App_load_stage(&app, "stages/test_stage.bin");
+    App app = App_new(&playlist);
 
-    Tool tool;
+    Tool tool = {0};  // also clears the fields of the tools picked later
     tool.type = TOOL_TILE_MODIFIER;
 
-    InputState input_state;
-    u32 last_ticks = SDL_GetTicks();
+    InputState input_state = {false, false, false, false, false};
+    u64 last_time = SDL_GetPerformanceCounter();
 
     while (true) {
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             switch (event.type) {
                 case SDL_QUIT: goto quit;
-                case SDL_MOUSEBUTTONDOWN:
+                case SDL_MOUSEBUTTONDOWN: {
                     input_state.mouse_down = true;
+                    i32 stage_x, stage_y;
+                    if (Minimap_to_stage(&app.minimap, event.button.x, event.button.y, &stage_x, &stage_y)) {
+                        app.dragging_minimap = true;
+                        App_center_camera(&app, stage_x, stage_y);
+                        break;
+                    }
                     switch (tool.type) {
                     case TOOL_TILE_MODIFIER: {
-                        bool *tile = Stage_tile_at(app.stage, event.motion.x, event.motion.y);
-                        if (tile != NULL) {
-                            *tile = !(*tile);
-                            tool.tile_modifier.mode = *tile;
+                        bool tile = !App_tile_at(&app, event.button.x, event.button.y);
+                        if (App_set_tile_at(&app, event.button.x, event.button.y, tile)) {
+                            tool.tile_modifier.mode = tile;
                         }
                         break;
                     }
                     case TOOL_PLAYER_PLACER:
                         app.player.show = true;
-                        app.player.x = event.motion.x;
-                        app.player.y = event.motion.y;
+                        i32 stage_x, stage_y;
+                        App_to_stage(&app, event.button.x, event.button.y, &stage_x, &stage_y);
+                        app.player.x = stage_x;
+                        app.player.y = stage_y;
+                        // no sliding over from where it was
+                        app.previous_player = app.player;
+                        break;
+                    case TOOL_REGION_SELECTOR:
+                        App_screen_to_tile(
+                            &app,
+                            event.button.x, event.button.y,
+                            &tool.region_selector.anchor_col, &tool.region_selector.anchor_row
+                        );
+                        App_select(
+                            &app,
+                            tool.region_selector.anchor_col, tool.region_selector.anchor_row,
+                            tool.region_selector.anchor_col, tool.region_selector.anchor_row
+                        );
                         break;
+                    case TOOL_LIGHT_PLACER: {
+                        i64 col, row;
+                        App_screen_to_tile(&app, event.button.x, event.button.y, &col, &row);
+                        Lighting_toggle_light(&app.lighting, col, row);
+                        break;
+                    }
                     case TOOL_COUNT: break;
                     }
                     break;
+                }
                 case SDL_MOUSEBUTTONUP:
                     input_state.mouse_down = false;
+                    app.dragging_minimap = false;
                     break;
                 case SDL_MOUSEMOTION:
-                    if (input_state.mouse_down) {
+                    if (app.dragging_minimap) {
+                        i32 stage_x, stage_y;
+                        if (Minimap_to_stage(&app.minimap, event.motion.x, event.motion.y, &stage_x, &stage_y)) {
+                            App_center_camera(&app, stage_x, stage_y);
+                        }
+                    } else if (input_state.mouse_down) {
                         switch (tool.type) {
-                        case TOOL_TILE_MODIFIER: {
-                            bool *tile = Stage_tile_at(app.stage, event.motion.x, event.motion.y);
-                            if (tile != NULL) {
-                                *tile = tool.tile_modifier.mode;
-                            }
+                        case TOOL_TILE_MODIFIER:
+                            App_paint_line(
+                                &app,
+                                event.motion.x - event.motion.xrel, event.motion.y - event.motion.yrel,
+                                event.motion.x, event.motion.y,
+                                tool.tile_modifier.mode
+                            );
                             break;
-                        }
                         case TOOL_PLAYER_PLACER:
                             break;
+                        case TOOL_REGION_SELECTOR: {
+                            i64 col, row;
+                            App_screen_to_tile(&app, event.motion.x, event.motion.y, &col, &row);
+                            App_select(
+                                &app,
+                                tool.region_selector.anchor_col, tool.region_selector.anchor_row,
+                                col, row
+                            );
+                            break;
+                        }
+                        case TOOL_LIGHT_PLACER: break;
                         case TOOL_COUNT: break;
                         }
                     }
                     break;
+                case SDL_MOUSEWHEEL:
+                    // scroll the stage, horizontally when shift is held, zoom
+                    // around the mouse cursor when ctrl is held
+                    if (SDL_GetModState() & KMOD_CTRL) {
+                        int x, y;
+                        SDL_GetMouseState(&x, &y);
+                        App_zoom(&app, -event.wheel.y, x, y);
+                    } else if (SDL_GetModState() & KMOD_SHIFT) {
+                        app.camera.x -= event.wheel.y * TILE_SIZE * (1 << app.camera.zoom);
+                    } else {
+                        app.camera.x += event.wheel.x * TILE_SIZE * (1 << app.camera.zoom);
+                        app.camera.y -= event.wheel.y * TILE_SIZE * (1 << app.camera.zoom);
+                    }
+                    break;
                 case SDL_KEYDOWN:
                     if (event.key.repeat != 0) { break; }
                     switch (event.key.keysym.scancode) {
@@ -199,22 +627,65 @@ int main() {
                     case SDL_SCANCODE_G:
                         app.show_grid = !app.show_grid;
                         break;
+                    case SDL_SCANCODE_MINUS:
+                        App_zoom(&app, 1, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
+                        break;
+                    case SDL_SCANCODE_EQUALS:
+                        App_zoom(&app, -1, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
+                        break;
+                    case SDL_SCANCODE_R:
+                        App_generate_stage(&app, SDL_GetPerformanceCounter());
+                        break;
+                    case SDL_SCANCODE_O:
+                        // join (or start) the live session of the stage, or leave it
+                        if (app.live.role == LIVE_OFF) {
+                            Live_start(&app.live, app.stage_name);
+                        } else {
+                            Live_print_stats(&app.live);
+                            Live_stop(&app.live);
+                        }
+                        break;
+                    case SDL_SCANCODE_L:
+                        app.show_lighting = !app.show_lighting;
+                        break;
                     case SDL_SCANCODE_S:
                         Stage_save(app.stage, app.stage_name);
+                        Playlist_set_modified(app.playlist, false);
                         printf("Saved to %s\n", app.stage_name);
                         break;
+                    case SDL_SCANCODE_N:
+                        App_switch_stage(&app, true);
+                        break;
+                    case SDL_SCANCODE_P:
+                        App_switch_stage(&app, false);
+                        break;
                     case SDL_SCANCODE_T:
                         tool.type = (tool.type + 1) % TOOL_COUNT;
+                        app.selection.w = 0;
                         switch (tool.type) {
                         case TOOL_TILE_MODIFIER:
                             tool.tile_modifier.mode = TILE_MODIFIER_TOOL_MODE_ADD;
                         case TOOL_PLAYER_PLACER: break;
+                        case TOOL_REGION_SELECTOR: break;
+                        case TOOL_LIGHT_PLACER: break;
                         case TOOL_COUNT: break;
                         }
                         break;
+                    case SDL_SCANCODE_C:
+                        App_copy_selection(&app);
+                        break;
+                    case SDL_SCANCODE_V:
+                        App_paste_clipboard(&app, BLIT_MODE_PASTE);
+                        break;
+                    case SDL_SCANCODE_B:
+                        App_paste_clipboard(&app, BLIT_MODE_STAMP);
+                        break;
                     case SDL_SCANCODE_SPACE:
                         input_state.space_down = true;
                         break;
+                    case SDL_SCANCODE_BACKSPACE:
+                        input_state.rewind_down = true;
+                        break;
                     case SDL_SCANCODE_LEFT:
                         input_state.left_down = true;
                         break;
@@ -236,23 +707,38 @@ int main() {
                     case SDL_SCANCODE_SPACE:
                         input_state.space_down = false;
                         break;
+                    case SDL_SCANCODE_BACKSPACE:
+                        input_state.rewind_down = false;
+                        Rewind_print_stats(&app.rewind);
+                        break;
                     default: break;
                     }
                     break;
             }
         }
-        u32 curr_ticks = SDL_GetTicks();
-        u32 ticks_diff = curr_ticks - last_ticks;
-        Player_update(&app.player, app.stage, ticks_diff, input_state);
+        LiveChanges changes = Live_poll(&app.live, app.stage);
+        if (changes.resized) {
+            App_rebuild_views(&app);
+        }
+        App_mark_modified(&app, changes.first_row, changes.last_row);
+        Live_flush(&app.live);
+
+        u64 curr_time = SDL_GetPerformanceCounter();
+        App_step_physics(&app, curr_time - last_time, input_state);
+        last_time = curr_time;
+        App_update_camera(&app);
 
-        if (ticks_diff > 0) {
-            last_ticks = curr_ticks;
-            App_render(app);
+        Minimap_update(&app.minimap, app.stage);
+        Pyramid_update(&app.pyramid);
+        if (app.show_lighting && app.camera.zoom == 0) {
+            Lighting_update(&app.lighting, app.stage, app.camera, App_drawn_player(&app));
         }
-        SDL_Delay(5);
+        App_render(app);
+        SDL_Delay(1);
     }
 
 quit:
     App_destroy(app);
+    Playlist_destroy(&playlist);
     return 0;
 }
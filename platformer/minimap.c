@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include "minimap.h"
+
+#define SCREEN_WIDTH 1280
+#define SCREEN_HEIGHT 720
+#define TILE_SIZE 40
+
+#define MINIMAP_MAX_WIDTH 256
+#define MINIMAP_MAX_HEIGHT 144
+#define MINIMAP_MARGIN 10
+
+static inline u64 div_ceil(u64 a, u64 b) {
+    return (a + b - 1) / b;
+}
+
+void Minimap_init(Minimap *minimap, SDL_Renderer *renderer, const Stage *stage) {
+    u64 scale_x = div_ceil(stage->width, MINIMAP_MAX_WIDTH);
+    u64 scale_y = div_ceil(stage->height, MINIMAP_MAX_HEIGHT);
+    minimap->scale = scale_x > scale_y ? scale_x : scale_y;
+    if (minimap->scale == 0) { minimap->scale = 1; }
+    minimap->width = div_ceil(stage->width, minimap->scale);
+    minimap->height = div_ceil(stage->height, minimap->scale);
+    minimap->pixels = malloc(sizeof(u32) * minimap->width * minimap->height);
+    minimap->texture = SDL_CreateTexture(
+        renderer,
+        SDL_PIXELFORMAT_RGBA8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        minimap->width,
+        minimap->height
+    );
+    if (minimap->texture == NULL) { SDL_fail(); }
+    SDL_SetTextureBlendMode(minimap->texture, SDL_BLENDMODE_BLEND);
+    minimap->dirty_first_row = 1;
+    minimap->dirty_last_row = 0;
+    Minimap_mark_dirty(minimap, 0, stage->height - 1);
+    Minimap_update(minimap, stage);
+}
+
+void Minimap_destroy(Minimap *minimap) {
+    SDL_DestroyTexture(minimap->texture);
+    minimap->texture = NULL;
+    free(minimap->pixels);
+    minimap->pixels = NULL;
+}
+
+/**
+ * Mark tile rows from `first_row` to `last_row` (inclusive) as changed.
+ */
+void Minimap_mark_dirty(Minimap *minimap, u64 first_row, u64 last_row) {
+    if (minimap->dirty_first_row > minimap->dirty_last_row) {
+        minimap->dirty_first_row = first_row;
+        minimap->dirty_last_row = last_row;
+        return;
+    }
+    if (first_row < minimap->dirty_first_row) { minimap->dirty_first_row = first_row; }
+    if (last_row > minimap->dirty_last_row) { minimap->dirty_last_row = last_row; }
+}
+
+/**
+ * Regenerate the dirty pixel rows and upload only them to the texture.
+ */
+void Minimap_update(Minimap *minimap, const Stage *stage) {
+    if (minimap->dirty_first_row > minimap->dirty_last_row) {
+        return;
+    }
+    u64 first = minimap->dirty_first_row / minimap->scale;
+    u64 last = minimap->dirty_last_row / minimap->scale;
+    if (last >= minimap->height) { last = minimap->height - 1; }
+    for (u64 py = first; py <= last; py++) {
+        u64 row = py * minimap->scale;
+        u64 rows = stage->height - row < minimap->scale ? stage->height - row : minimap->scale;
+        for (u64 px = 0; px < minimap->width; px++) {
+            u64 col = px * minimap->scale;
+            u64 cols = stage->width - col < minimap->scale ? stage->width - col : minimap->scale;
+            u64 solid = 0;
+            for (u64 r = row; r < row + rows; r++) {
+                solid += Stage_count_tiles(stage, r, col, cols);
+            }
+            u32 density = solid * 255 / (rows * cols);
+            // translucent dark green when empty, opaque bright green when full
+            u32 green = 64 + density * 3 / 4;
+            u32 alpha = 128 + density / 2;
+            minimap->pixels[py * minimap->width + px] = (green << 16) | alpha;
+        }
+    }
+    SDL_Rect rect = {0, first, minimap->width, last - first + 1};
+    SDL_UpdateTexture(
+        minimap->texture,
+        &rect,
+        minimap->pixels + first * minimap->width,
+        sizeof(u32) * minimap->width
+    );
+    minimap->dirty_first_row = 1;
+    minimap->dirty_last_row = 0;
+}
+
+/**
+ * Rectangle on the screen the minimap is drawn into.
+ */
+SDL_Rect Minimap_rect(const Minimap *minimap) {
+    f32 zoom_x = (f32)MINIMAP_MAX_WIDTH / minimap->width;
+    f32 zoom_y = (f32)MINIMAP_MAX_HEIGHT / minimap->height;
+    f32 zoom = zoom_x < zoom_y ? zoom_x : zoom_y;
+    int w = minimap->width * zoom, h = minimap->height * zoom;
+    return (SDL_Rect){SCREEN_WIDTH - w - MINIMAP_MARGIN, MINIMAP_MARGIN, w, h};
+}
+
+// minimap pixels per stage pixel
+static f32 Minimap_zoom(const Minimap *minimap, SDL_Rect rect) {
+    return (f32)rect.w / (minimap->width * minimap->scale * TILE_SIZE);
+}
+
+/**
+ * Translate a point on the screen into stage pixels. Returns false when the
+ * point is not on the minimap.
+ */
+bool Minimap_to_stage(const Minimap *minimap, i32 x, i32 y, i32 *stage_x, i32 *stage_y) {
+    SDL_Rect rect = Minimap_rect(minimap);
+    SDL_Point point = {x, y};
+    if (!SDL_PointInRect(&point, &rect)) {
+        return false;
+    }
+    f32 zoom = Minimap_zoom(minimap, rect);
+    *stage_x = (x - rect.x) / zoom;
+    *stage_y = (y - rect.y) / zoom;
+    return true;
+}
+
+void Minimap_draw(
+    const Minimap *minimap,
+    SDL_ScaledRenderer scaled_renderer,
+    Camera camera,
+    Player player
+) {
+    SDL_Rect rect = Minimap_rect(minimap);
+    SDL_ScaledRenderCopy(scaled_renderer, minimap->texture, NULL, &rect);
+    f32 zoom = Minimap_zoom(minimap, rect);
+
+    // visible part of the stage
+    SDL_Rect view = {
+        rect.x + camera.x * zoom,
+        rect.y + camera.y * zoom,
+        (SCREEN_WIDTH << camera.zoom) * zoom,
+        (SCREEN_HEIGHT << camera.zoom) * zoom
+    };
+    SDL_SetRenderDrawColor(scaled_renderer.renderer, 255, 255, 255, 255);
+    SDL_ScaledRenderDrawRect(scaled_renderer, &view);
+
+    if (player.show) {
+        SDL_Rect marker = {rect.x + player.x * zoom - 2, rect.y + player.y * zoom - 2, 5, 5};
+        SDL_SetRenderDrawColor(scaled_renderer.renderer, 220, 30, 30, 255);
+        SDL_ScaledRenderFillRect(scaled_renderer, &marker);
+    }
+}
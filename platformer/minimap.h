@@ -0,0 +1,37 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <stdbool.h>
+#include <SDL.h>
+#include "SDL_utils.h"
+#include "stage.h"
+#include "types.h"
+
+/**
+ * Overview of the whole stage drawn in the corner of the screen. Every pixel
+ * covers a `scale` x `scale` block of tiles and gets a brighter and more
+ * opaque green the more of them are solid. Pixels are kept in a streaming
+ * texture and only the rows marked dirty are regenerated and uploaded.
+ */
+typedef struct {
+    SDL_Texture *texture;
+    u32 *pixels;
+    u64 width, height;  // in pixels
+    u64 scale;          // tiles per pixel, in both directions
+    u64 dirty_first_row, dirty_last_row;  // in tiles, first > last when clean
+} Minimap;
+
+void Minimap_init(Minimap *minimap, SDL_Renderer *renderer, const Stage *stage);
+void Minimap_destroy(Minimap *minimap);
+void Minimap_mark_dirty(Minimap *minimap, u64 first_row, u64 last_row);
+void Minimap_update(Minimap *minimap, const Stage *stage);
+SDL_Rect Minimap_rect(const Minimap *minimap);
+bool Minimap_to_stage(const Minimap *minimap, i32 x, i32 y, i32 *stage_x, i32 *stage_y);
+void Minimap_draw(
+    const Minimap *minimap,
+    SDL_ScaledRenderer scaled_renderer,
+    Camera camera,
+    Player player
+);
+
+#endif // MINIMAP_H
@@ -0,0 +1,198 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "playlist.h"
+
+static f64 ms_since(u64 start) {
+    return (SDL_GetPerformanceCounter() - start) * 1000. / SDL_GetPerformanceFrequency();
+}
+
+/**
+ * Distance between the entry and the current entry, the playlist wraps around.
+ */
+static size_t Playlist_distance(const Playlist *playlist, size_t index) {
+    size_t forward = (index + playlist->count - playlist->current) % playlist->count;
+    size_t backward = (playlist->current + playlist->count - index) % playlist->count;
+    return forward < backward ? forward : backward;
+}
+
+/**
+ * Pick the next entry for the loader: the current stage first, then the next
+ * one and then the previous one. Must be called with the mutex locked.
+ */
+static PlaylistEntry *Playlist_pick_entry_to_load(Playlist *playlist) {
+    size_t candidates[] = {
+        playlist->current,
+        (playlist->current + 1) % playlist->count,
+        (playlist->current + playlist->count - 1) % playlist->count,
+    };
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        PlaylistEntry *entry = &playlist->entries[candidates[i]];
+        if (entry->stage == NULL && !entry->loading) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static int Playlist_loader(void *data) {
+    Playlist *playlist = data;
+    SDL_LockMutex(playlist->mutex);
+    while (!playlist->quit) {
+        PlaylistEntry *entry = Playlist_pick_entry_to_load(playlist);
+        if (entry == NULL) {
+            SDL_CondWait(playlist->cond, playlist->mutex);
+            continue;
+        }
+        entry->loading = true;
+        SDL_UnlockMutex(playlist->mutex);
+
+        u64 start = SDL_GetPerformanceCounter();
+        Stage *stage = malloc(sizeof(Stage));
+        Stage_load(stage, entry->file_name);
+        printf(
+            "Loaded %s (%lux%lu) in %.2f ms\n",
+            entry->file_name, stage->width, stage->height, ms_since(start)
+        );
+
+        SDL_LockMutex(playlist->mutex);
+        entry->stage = stage;
+        entry->loading = false;
+        SDL_CondBroadcast(playlist->cond);
+    }
+    SDL_UnlockMutex(playlist->mutex);
+    return 0;
+}
+
+void Playlist_init(Playlist *playlist, char **file_names, size_t count) {
+    if (count == 0) {
+        printf("Playlist is empty\n");
+        exit(1);
+    }
+    playlist->entries = malloc(sizeof(PlaylistEntry) * count);
+    for (size_t i = 0; i < count; i++) {
+        playlist->entries[i] = (PlaylistEntry){
+            .file_name = strdup(file_names[i]),
+            .stage = NULL,
+            .loading = false,
+            .modified = false
+        };
+    }
+    playlist->count = count;
+    playlist->current = 0;
+    playlist->quit = false;
+    playlist->mutex = SDL_CreateMutex();
+    playlist->cond = SDL_CreateCond();
+    if (playlist->mutex == NULL || playlist->cond == NULL) { SDL_fail(); }
+    playlist->thread = SDL_CreateThread(Playlist_loader, "stage loader", playlist);
+    if (playlist->thread == NULL) { SDL_fail(); }
+}
+
+void Playlist_destroy(Playlist *playlist) {
+    SDL_LockMutex(playlist->mutex);
+    playlist->quit = true;
+    SDL_CondBroadcast(playlist->cond);
+    SDL_UnlockMutex(playlist->mutex);
+    SDL_WaitThread(playlist->thread, NULL);
+
+    for (size_t i = 0; i < playlist->count; i++) {
+        if (playlist->entries[i].stage != NULL) {
+            Stage_destroy(playlist->entries[i].stage);
+            free(playlist->entries[i].stage);
+        }
+        free(playlist->entries[i].file_name);
+    }
+    free(playlist->entries);
+    SDL_DestroyCond(playlist->cond);
+    SDL_DestroyMutex(playlist->mutex);
+}
+
+/**
+ * Get the current stage. Blocks only if the loader has not finished it yet.
+ */
+Stage *Playlist_current(Playlist *playlist) {
+    SDL_LockMutex(playlist->mutex);
+    PlaylistEntry *entry = &playlist->entries[playlist->current];
+    if (entry->stage == NULL) {
+        u64 start = SDL_GetPerformanceCounter();
+        while (entry->stage == NULL) {
+            SDL_CondWait(playlist->cond, playlist->mutex);
+        }
+        printf("Waited %.2f ms for %s\n", ms_since(start), entry->file_name);
+    }
+    Stage *stage = entry->stage;
+    SDL_UnlockMutex(playlist->mutex);
+    return stage;
+}
+
+const char *Playlist_current_name(const Playlist *playlist) {
+    return playlist->entries[playlist->current].file_name;
+}
+
+static Stage *Playlist_move_to(Playlist *playlist, size_t index) {
+    SDL_LockMutex(playlist->mutex);
+    playlist->current = index;
+    for (size_t i = 0; i < playlist->count; i++) {
+        PlaylistEntry *entry = &playlist->entries[i];
+        if (entry->stage != NULL && !entry->modified && Playlist_distance(playlist, i) > 1) {
+            Stage_destroy(entry->stage);
+            free(entry->stage);
+            entry->stage = NULL;
+        }
+    }
+    SDL_CondBroadcast(playlist->cond);
+    SDL_UnlockMutex(playlist->mutex);
+    return Playlist_current(playlist);
+}
+
+Stage *Playlist_next(Playlist *playlist) {
+    return Playlist_move_to(playlist, (playlist->current + 1) % playlist->count);
+}
+
+Stage *Playlist_prev(Playlist *playlist) {
+    return Playlist_move_to(playlist, (playlist->current + playlist->count - 1) % playlist->count);
+}
+
+/**
+ * Mark the current stage as (not) having unsaved changes.
+ */
+void Playlist_set_modified(Playlist *playlist, bool modified) {
+    SDL_LockMutex(playlist->mutex);
+    playlist->entries[playlist->current].modified = modified;
+    SDL_UnlockMutex(playlist->mutex);
+}
+
+static int compare_file_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Collect all the ".bin" files from `dir_name`, sorted by name.
+ */
+size_t Playlist_list_files(const char *dir_name, char ***file_names) {
+    size_t count = 0, capacity = 8;
+    *file_names = malloc(sizeof(char *) * capacity);
+    struct dirent *entry;
+    DIR *dp = opendir(dir_name);
+    if (dp == NULL) {
+        printf("Failed to open: %s\n", dir_name);
+        exit(1);
+    }
+    while ((entry = readdir(dp))) {
+        size_t len = strlen(entry->d_name);
+        if (len < 4 || strcmp(entry->d_name + len - 4, ".bin") != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            *file_names = realloc(*file_names, sizeof(char *) * capacity);
+        }
+        char *file_name = malloc(strlen(dir_name) + len + 2);
+        sprintf(file_name, "%s/%s", dir_name, entry->d_name);
+        (*file_names)[count++] = file_name;
+    }
+    closedir(dp);
+    qsort(*file_names, count, sizeof(char *), compare_file_names);
+    return count;
+}
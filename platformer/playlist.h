@@ -0,0 +1,40 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <stdbool.h>
+#include <SDL.h>
+#include "stage.h"
+#include "types.h"
+
+typedef struct {
+    char *file_name;
+    Stage *stage;  // NULL until loaded by the background thread
+    bool loading;
+    bool modified; // modified stages are kept in memory until saved
+} PlaylistEntry;
+
+/**
+ * Ordered list of stage files. The current stage and its neighbours are
+ * loaded on a background thread so that switching stages is a pointer swap.
+ * Stages further away are unloaded, unless they have unsaved changes.
+ */
+typedef struct {
+    PlaylistEntry *entries;
+    size_t count;
+    size_t current;
+    SDL_Thread *thread;
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    bool quit;
+} Playlist;
+
+void Playlist_init(Playlist *playlist, char **file_names, size_t count);
+void Playlist_destroy(Playlist *playlist);
+Stage *Playlist_current(Playlist *playlist);
+const char *Playlist_current_name(const Playlist *playlist);
+Stage *Playlist_next(Playlist *playlist);
+Stage *Playlist_prev(Playlist *playlist);
+void Playlist_set_modified(Playlist *playlist, bool modified);
+size_t Playlist_list_files(const char *dir_name, char ***file_names);
+
+#endif // PLAYLIST_H
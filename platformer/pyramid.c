@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pyramid.h"
+
+#define SCREEN_WIDTH 1280
+#define SCREEN_HEIGHT 720
+#define TILE_SIZE 40
+
+#define WORD_BITS 64
+// the texture covers the screen with one pixel per cell, plus a partial cell
+#define TEXTURE_WIDTH (SCREEN_WIDTH + 1)
+#define TEXTURE_HEIGHT (SCREEN_HEIGHT + 1)
+
+static inline u64 words_for(u64 bits) {
+    return (bits + WORD_BITS - 1) / WORD_BITS;
+}
+
+static inline i64 floor_div(i64 a, i64 b) {
+    i64 q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+/**
+ * Word `i` of a level row, without the bits past the end of the row (the stage
+ * keeps solid border tiles there).
+ */
+static inline u64 row_word(const PyramidLevel *level, const u64 *row, u64 i) {
+    u64 words = words_for(level->width);
+    if (i >= words) { return 0; }
+    u64 rest = level->width - i * WORD_BITS;
+    return rest >= WORD_BITS ? row[i] : row[i] & (((u64)1 << rest) - 1);
+}
+
+/**
+ * OR every pair of neighbouring bits and pack the pairs into the low 32 bits.
+ */
+static inline u64 reduce_pairs(u64 x) {
+    x = (x | (x >> 1)) & 0x5555555555555555;
+    x = (x | (x >> 1)) & 0x3333333333333333;
+    x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0f;
+    x = (x | (x >> 4)) & 0x00ff00ff00ff00ff;
+    x = (x | (x >> 8)) & 0x0000ffff0000ffff;
+    x = (x | (x >> 16)) & 0x00000000ffffffff;
+    return x;
+}
+
+static void Pyramid_reduce_row(const PyramidLevel *src, PyramidLevel *dst, u64 row) {
+    const u64 *top = src->bits + 2 * row * src->stride;
+    const u64 *bottom = 2 * row + 1 < src->height ? top + src->stride : NULL;
+    u64 *out = dst->bits + row * dst->stride;
+    for (u64 i = 0; i < dst->stride; i++) {
+        u64 lo = row_word(src, top, 2 * i), hi = row_word(src, top, 2 * i + 1);
+        if (bottom != NULL) {
+            lo |= row_word(src, bottom, 2 * i);
+            hi |= row_word(src, bottom, 2 * i + 1);
+        }
+        out[i] = reduce_pairs(lo) | (reduce_pairs(hi) << 32);
+    }
+}
+
+void Pyramid_init(Pyramid *pyramid, SDL_Renderer *renderer, const Stage *stage) {
+    pyramid->levels[0] = (PyramidLevel){
+        .width = stage->width,
+        .height = stage->height,
+        .stride = stage->stride,
+        .bits = stage->tiles
+    };
+    pyramid->level_count = 1;
+    while (pyramid->level_count < PYRAMID_MAX_LEVELS) {
+        const PyramidLevel *prev = &pyramid->levels[pyramid->level_count - 1];
+        if (prev->width <= 1 && prev->height <= 1) { break; }
+        PyramidLevel *level = &pyramid->levels[pyramid->level_count++];
+        level->width = (prev->width + 1) / 2;
+        level->height = (prev->height + 1) / 2;
+        level->stride = words_for(level->width);
+        level->bits = malloc(sizeof(u64) * level->stride * level->height);
+    }
+    pyramid->pixels = malloc(sizeof(u32) * TEXTURE_WIDTH * TEXTURE_HEIGHT);
+    pyramid->texture = SDL_CreateTexture(
+        renderer,
+        SDL_PIXELFORMAT_RGBA8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        TEXTURE_WIDTH,
+        TEXTURE_HEIGHT
+    );
+    if (pyramid->texture == NULL) { SDL_fail(); }
+    SDL_SetTextureBlendMode(pyramid->texture, SDL_BLENDMODE_BLEND);
+    pyramid->dirty_first_row = 1;
+    pyramid->dirty_last_row = 0;
+    Pyramid_mark_dirty(pyramid, 0, stage->height - 1);
+    Pyramid_update(pyramid);
+}
+
+void Pyramid_destroy(Pyramid *pyramid) {
+    // level 0 belongs to the stage
+    for (u64 i = 1; i < pyramid->level_count; i++) {
+        free(pyramid->levels[i].bits);
+        pyramid->levels[i].bits = NULL;
+    }
+    pyramid->level_count = 0;
+    SDL_DestroyTexture(pyramid->texture);
+    pyramid->texture = NULL;
+    free(pyramid->pixels);
+    pyramid->pixels = NULL;
+}
+
+/**
+ * Mark tile rows from `first_row` to `last_row` (inclusive) as changed.
+ */
+void Pyramid_mark_dirty(Pyramid *pyramid, u64 first_row, u64 last_row) {
+    if (pyramid->dirty_first_row > pyramid->dirty_last_row) {
+        pyramid->dirty_first_row = first_row;
+        pyramid->dirty_last_row = last_row;
+        return;
+    }
+    if (first_row < pyramid->dirty_first_row) { pyramid->dirty_first_row = first_row; }
+    if (last_row > pyramid->dirty_last_row) { pyramid->dirty_last_row = last_row; }
+}
+
+/**
+ * Reduce the dirty rows again, level by level.
+ */
+void Pyramid_update(Pyramid *pyramid) {
+    if (pyramid->dirty_first_row > pyramid->dirty_last_row) {
+        return;
+    }
+    for (u64 i = 1; i < pyramid->level_count; i++) {
+        PyramidLevel *level = &pyramid->levels[i];
+        u64 first = pyramid->dirty_first_row >> i;
+        u64 last = pyramid->dirty_last_row >> i;
+        if (last >= level->height) { last = level->height - 1; }
+        for (u64 row = first; row <= last; row++) {
+            Pyramid_reduce_row(&pyramid->levels[i - 1], level, row);
+        }
+    }
+    pyramid->dirty_first_row = 1;
+    pyramid->dirty_last_row = 0;
+}
+
+/**
+ * Draw the stage from the coarsest level whose cells are still at least one
+ * screen pixel wide, so that the cost depends on the screen size only.
+ */
+void Pyramid_draw(Pyramid *pyramid, SDL_ScaledRenderer scaled_renderer, Camera camera) {
+    u64 level_index = 0;
+    while (level_index + 1 < pyramid->level_count
+           && ((u64)TILE_SIZE << level_index) < ((u64)1 << camera.zoom)) {
+        level_index++;
+    }
+    const PyramidLevel *level = &pyramid->levels[level_index];
+    i64 cell_size = (i64)TILE_SIZE << level_index;  // in stage pixels
+    i64 first_col = floor_div(camera.x, cell_size);
+    i64 first_row = floor_div(camera.y, cell_size);
+    i64 last_col = floor_div(camera.x + ((i64)SCREEN_WIDTH << camera.zoom) - 1, cell_size);
+    i64 last_row = floor_div(camera.y + ((i64)SCREEN_HEIGHT << camera.zoom) - 1, cell_size);
+    if (first_col < 0) { first_col = 0; }
+    if (first_row < 0) { first_row = 0; }
+    if (last_col >= (i64)level->width) { last_col = level->width - 1; }
+    if (last_row >= (i64)level->height) { last_row = level->height - 1; }
+    if (last_col - first_col + 1 > TEXTURE_WIDTH) { last_col = first_col + TEXTURE_WIDTH - 1; }
+    if (last_row - first_row + 1 > TEXTURE_HEIGHT) { last_row = first_row + TEXTURE_HEIGHT - 1; }
+    if (first_col > last_col || first_row > last_row) {
+        return;
+    }
+
+    i64 cols = last_col - first_col + 1, rows = last_row - first_row + 1;
+    for (i64 r = 0; r < rows; r++) {
+        const u64 *bits = level->bits + (first_row + r) * level->stride;
+        u32 *pixels = pyramid->pixels + r * cols;
+        for (i64 c = 0; c < cols; c++) {
+            u64 col = first_col + c;
+            // solid cells get the tile color, empty ones are transparent
+            pixels[c] = (bits[col / WORD_BITS] >> (col % WORD_BITS)) & 1 ? 0x008000ff : 0;
+        }
+    }
+    SDL_Rect src = {0, 0, cols, rows};
+    SDL_UpdateTexture(pyramid->texture, &src, pyramid->pixels, sizeof(u32) * cols);
+    SDL_Rect dst = {
+        floor_div(first_col * cell_size - camera.x, (i64)1 << camera.zoom),
+        floor_div(first_row * cell_size - camera.y, (i64)1 << camera.zoom),
+        (cols * cell_size) >> camera.zoom,
+        (rows * cell_size) >> camera.zoom
+    };
+    SDL_ScaledRenderCopy(scaled_renderer, pyramid->texture, &src, &dst);
+}
@@ -0,0 +1,41 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <stdbool.h>
+#include <SDL.h>
+#include "SDL_utils.h"
+#include "stage.h"
+#include "types.h"
+
+#define PYRAMID_MAX_LEVELS 48
+
+/**
+ * Bit-packed occupancy grid, a cell is set when any tile it covers is solid.
+ */
+typedef struct {
+    u64 width, height;  // in cells
+    u64 stride;         // in words
+    u64 *bits;
+} PyramidLevel;
+
+/**
+ * Occupancy of the stage at decreasing resolutions, used to draw the stage
+ * zoomed out. Level 0 is the stage itself and every cell of level `k + 1`
+ * is the OR of 2x2 cells of level `k`. Edited rows are marked dirty and
+ * reduced again on the next update, a word of 64 cells at a time.
+ */
+typedef struct {
+    PyramidLevel levels[PYRAMID_MAX_LEVELS];
+    u64 level_count;
+    u64 dirty_first_row, dirty_last_row;  // in tiles, first > last when clean
+    SDL_Texture *texture;  // one pixel per cell on the screen
+    u32 *pixels;
+} Pyramid;
+
+void Pyramid_init(Pyramid *pyramid, SDL_Renderer *renderer, const Stage *stage);
+void Pyramid_destroy(Pyramid *pyramid);
+void Pyramid_mark_dirty(Pyramid *pyramid, u64 first_row, u64 last_row);
+void Pyramid_update(Pyramid *pyramid);
+void Pyramid_draw(Pyramid *pyramid, SDL_ScaledRenderer scaled_renderer, Camera camera);
+
+#endif // PYRAMID_H
@@ -0,0 +1,227 @@
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rewind.h"
+
+#define MAX_DY 0.5
+#define GRAVITY 0.004
+
+/**
+ * Every step starts with a header byte telling which fields are stored as is
+ * (4 bytes each, in this order) and which follow the prediction.
+ */
+#define LITERAL_X (1 << 0)
+#define LITERAL_Y (1 << 1)
+#define LITERAL_DX (1 << 2)
+#define LITERAL_DY (1 << 3)
+#define SHOW (1 << 4)
+#define KEYFRAME (LITERAL_X | LITERAL_Y | LITERAL_DX | LITERAL_DY)
+#define MAX_STEP_SIZE (1 + 4 * sizeof(f32))
+
+/**
+ * The state after `ticks` ticks if nothing happens: the player keeps the same
+ * horizontal speed, stays on the ground when not moving vertically and falls
+ * otherwise. Uses the same floating point operations as `Player_update`.
+ */
+static Player predict(Player prev, u32 ticks) {
+    Player next = prev;
+    for (u32 i = 0; i < ticks; i++) {
+        if (prev.dy != 0) {
+            next.dy += GRAVITY;
+            if (next.dy > MAX_DY) {
+                next.dy = MAX_DY;
+            }
+        }
+        next.y += next.dy;
+        next.x += next.dx;
+    }
+    return next;
+}
+
+/**
+ * Where the player ends up moving at `dx` for `ticks` ticks.
+ */
+static f32 advance_x(f32 x, f32 dx, u32 ticks) {
+    for (u32 i = 0; i < ticks; i++) {
+        x += dx;
+    }
+    return x;
+}
+
+static inline bool same(f32 a, f32 b) {
+    return memcmp(&a, &b, sizeof(f32)) == 0;
+}
+
+static void Rewind_write(Rewind *rewind, const void *src, u64 size) {
+    u64 start = rewind->head % rewind->capacity;
+    u64 first = rewind->capacity - start < size ? rewind->capacity - start : size;
+    memcpy(rewind->data + start, src, first);
+    memcpy(rewind->data, (const u8 *)src + first, size - first);
+    rewind->head += size;
+}
+
+static void Rewind_read(const Rewind *rewind, u64 position, void *dst, u64 size) {
+    u64 start = position % rewind->capacity;
+    u64 first = rewind->capacity - start < size ? rewind->capacity - start : size;
+    memcpy(dst, rewind->data + start, first);
+    memcpy((u8 *)dst + first, rewind->data, size - first);
+}
+
+static inline RewindBlock *Rewind_block(Rewind *rewind, u64 index) {
+    return &rewind->blocks[(rewind->first_block + index) % rewind->max_blocks];
+}
+
+/**
+ * Decode the step at `position` following `prev`, returns its size.
+ */
+static u64 Rewind_decode(const Rewind *rewind, u64 position, Player prev, Player *player) {
+    u8 header;
+    Rewind_read(rewind, position, &header, 1);
+    u64 size = 1;
+    Player next = predict(prev, rewind->step_ticks);
+    f32 *fields[] = {&next.x, &next.y, &next.dx, &next.dy};
+    for (int i = 0; i < 4; i++) {
+        if (header & (1 << i)) {
+            Rewind_read(rewind, position + size, fields[i], sizeof(f32));
+            size += sizeof(f32);
+        }
+    }
+    // x follows the new horizontal speed, not the previous one
+    if (!(header & LITERAL_X)) {
+        next.x = advance_x(prev.x, next.dx, rewind->step_ticks);
+    }
+    next.show = header & SHOW;
+    *player = next;
+    return size;
+}
+
+static void Rewind_encode(Rewind *rewind, Player prev, Player player, bool keyframe) {
+    Player predicted = predict(prev, rewind->step_ticks);
+    predicted.dx = player.dx;
+    predicted.x = advance_x(prev.x, player.dx, rewind->step_ticks);
+    u8 header = (player.show ? SHOW : 0) | (keyframe ? KEYFRAME : 0);
+    if (!same(player.x, predicted.x)) { header |= LITERAL_X; }
+    if (!same(player.y, predicted.y)) { header |= LITERAL_Y; }
+    if (!same(player.dx, prev.dx)) { header |= LITERAL_DX; }
+    if (!same(player.dy, predicted.dy)) { header |= LITERAL_DY; }
+    u8 buffer[MAX_STEP_SIZE];
+    u64 size = 0;
+    buffer[size++] = header;
+    f32 fields[] = {player.x, player.y, player.dx, player.dy};
+    for (int i = 0; i < 4; i++) {
+        if (header & (1 << i)) {
+            memcpy(buffer + size, &fields[i], sizeof(f32));
+            size += sizeof(f32);
+        }
+    }
+    Rewind_write(rewind, buffer, size);
+}
+
+void Rewind_init(Rewind *rewind, u64 capacity, u32 step_ticks) {
+    // the last block must always fit, whatever is dropped
+    if (capacity < 2 * REWIND_BLOCK_STEPS * MAX_STEP_SIZE) {
+        printf("Rewind buffer too small: %lu bytes\n", capacity);
+        exit(1);
+    }
+    rewind->data = malloc(capacity);
+    rewind->capacity = capacity;
+    rewind->step_ticks = step_ticks;
+    rewind->max_blocks = capacity / MAX_STEP_SIZE + 1;
+    rewind->blocks = malloc(sizeof(RewindBlock) * rewind->max_blocks);
+    Rewind_clear(rewind);
+}
+
+void Rewind_destroy(Rewind *rewind) {
+    free(rewind->data);
+    free(rewind->blocks);
+    rewind->data = NULL;
+    rewind->blocks = NULL;
+}
+
+void Rewind_clear(Rewind *rewind) {
+    rewind->head = 0;
+    rewind->tail = 0;
+    rewind->first_block = 0;
+    rewind->block_count = 0;
+    rewind->steps = 0;
+    rewind->recorded = 0;
+    rewind->rewound = 0;
+    rewind->record_time = 0;
+    rewind->rewind_time = 0;
+}
+
+static void Rewind_drop_oldest_block(Rewind *rewind) {
+    rewind->steps -= Rewind_block(rewind, 0)->steps;
+    rewind->first_block = (rewind->first_block + 1) % rewind->max_blocks;
+    rewind->block_count--;
+    rewind->tail = rewind->block_count > 0 ? Rewind_block(rewind, 0)->offset : rewind->head;
+}
+
+void Rewind_record(Rewind *rewind, Player player) {
+    u64 start = SDL_GetPerformanceCounter();
+    RewindBlock *last = rewind->block_count > 0 ? Rewind_block(rewind, rewind->block_count - 1) : NULL;
+    bool keyframe = last == NULL || last->steps == REWIND_BLOCK_STEPS;
+    while (rewind->head + MAX_STEP_SIZE - rewind->tail > rewind->capacity
+           || (keyframe && rewind->block_count == rewind->max_blocks)) {
+        Rewind_drop_oldest_block(rewind);
+    }
+    if (keyframe) {
+        rewind->block_count++;
+        last = Rewind_block(rewind, rewind->block_count - 1);
+        *last = (RewindBlock){.offset = rewind->head, .steps = 0};
+    }
+    rewind->offsets[last->steps] = rewind->head;
+    Rewind_encode(rewind, keyframe ? player : rewind->states[last->steps - 1], player, keyframe);
+    rewind->states[last->steps++] = player;
+    rewind->steps++;
+    rewind->recorded++;
+    rewind->record_time += SDL_GetPerformanceCounter() - start;
+}
+
+/**
+ * Drop the last state and go back to the one before. Returns false when
+ * there is nothing to go back to.
+ */
+bool Rewind_pop(Rewind *rewind, Player *player) {
+    if (rewind->steps < 2) {
+        return false;
+    }
+    u64 start = SDL_GetPerformanceCounter();
+    RewindBlock *last = Rewind_block(rewind, rewind->block_count - 1);
+    last->steps--;
+    rewind->head = rewind->offsets[last->steps];
+    rewind->steps--;
+    if (last->steps == 0) {
+        // decode the previous block, its first state is a keyframe
+        rewind->block_count--;
+        last = Rewind_block(rewind, rewind->block_count - 1);
+        u64 position = last->offset;
+        Player prev = {0};
+        for (u64 i = 0; i < last->steps; i++) {
+            rewind->offsets[i] = position;
+            position += Rewind_decode(rewind, position, prev, &rewind->states[i]);
+            prev = rewind->states[i];
+        }
+    }
+    *player = rewind->states[last->steps - 1];
+    rewind->rewound++;
+    rewind->rewind_time += SDL_GetPerformanceCounter() - start;
+    return true;
+}
+
+void Rewind_print_stats(const Rewind *rewind) {
+    f64 ns = 1e9 / SDL_GetPerformanceFrequency();
+    u64 used = rewind->head - rewind->tail;
+    printf(
+        "Rewind: %lu steps (%.1f s) in %.1f/%.1f KB (%.2f B/step), "
+        "record %.0f ns/step, rewind %.0f ns/step\n",
+        rewind->steps,
+        rewind->steps * rewind->step_ticks / 1000.,
+        used / 1024.,
+        rewind->capacity / 1024.,
+        rewind->steps ? (f64)used / rewind->steps : 0.,
+        rewind->recorded ? rewind->record_time * ns / rewind->recorded : 0.,
+        rewind->rewound ? rewind->rewind_time * ns / rewind->rewound : 0.
+    );
+}
@@ -0,0 +1,49 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdbool.h>
+#include "stage.h"
+#include "types.h"
+
+// steps between two keyframes
+#define REWIND_BLOCK_STEPS 256
+
+typedef struct {
+    u64 offset;  // of the keyframe
+    u64 steps;
+} RewindBlock;
+
+/**
+ * History of the player, one state per physics step of `step_ticks` ticks, in
+ * a ring buffer of a fixed number of bytes. Every state is stored as the
+ * difference to what `Player_update` would most likely do next, which takes a
+ * single byte for most steps. Every `REWIND_BLOCK_STEPS` steps a keyframe
+ * starts a new block, and when the buffer is full the oldest block is dropped.
+ *
+ * The last block is also kept decoded, so that rewinding is a pop from an
+ * array, and a block is only decoded again when the rewind moves into it.
+ */
+typedef struct {
+    u8 *data;
+    u64 capacity;
+    u32 step_ticks;
+    u64 head, tail;  // positions in bytes written since the start, not wrapped
+    RewindBlock *blocks;
+    u64 max_blocks;
+    u64 first_block, block_count;
+    Player states[REWIND_BLOCK_STEPS];  // the last block
+    u64 offsets[REWIND_BLOCK_STEPS];    // of the states of the last block
+    u64 steps;
+    // cost
+    u64 recorded, rewound;
+    u64 record_time, rewind_time;  // in performance counter units
+} Rewind;
+
+void Rewind_init(Rewind *rewind, u64 capacity, u32 step_ticks);
+void Rewind_destroy(Rewind *rewind);
+void Rewind_clear(Rewind *rewind);
+void Rewind_record(Rewind *rewind, Player player);
+bool Rewind_pop(Rewind *rewind, Player *player);
+void Rewind_print_stats(const Rewind *rewind);
+
+#endif // REWIND_H
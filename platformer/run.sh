@@ -1,4 +1,4 @@
-gcc main.c SDL_utils.c stage.c \
+gcc main.c SDL_utils.c generator.c lighting.c live.c minimap.c playlist.c pyramid.c rewind.c stage.c \
     -o platformer \
     -g \
     -Wall -Wextra -Wunreachable-code \
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include "stage.h"
@@ -13,15 +14,159 @@
 #define SIDE_MOVEMENT_SPEED 0.4
 #define GRAVITY 0.004
 
+#define WORD_BITS 64
+
+static inline u64 words_for(u64 bits) {
+    return (bits + WORD_BITS - 1) / WORD_BITS;
+}
+
+// mask with the lowest `count` bits set, `count` in [0, 64]
+static inline u64 low_bits(u64 count) {
+    return count >= WORD_BITS ? ~(u64)0 : ((u64)1 << count) - 1;
+}
+
+static inline bool get_bit(const u64 *row, u64 col) {
+    return (row[col / WORD_BITS] >> (col % WORD_BITS)) & 1;
+}
+
+static inline void set_bit(u64 *row, u64 col, bool value) {
+    u64 mask = (u64)1 << (col % WORD_BITS);
+    row[col / WORD_BITS] = value ? row[col / WORD_BITS] | mask : row[col / WORD_BITS] & ~mask;
+}
+
+/**
+ * Read `count` (at most 64) bits of `row` starting at bit `offset`.
+ */
+static inline u64 read_bits(const u64 *row, u64 offset, u64 count) {
+    u64 word = offset / WORD_BITS, shift = offset % WORD_BITS;
+    u64 value = row[word] >> shift;
+    if (shift != 0 && shift + count > WORD_BITS) {
+        value |= row[word + 1] << (WORD_BITS - shift);
+    }
+    return value & low_bits(count);
+}
+
+/**
+ * Write the lowest `count` (at most 64) bits of `value` into `row` starting at
+ * bit `offset`. In `BLIT_MODE_STAMP` bits are only ever set.
+ */
+static inline void write_bits(u64 *row, u64 offset, u64 value, u64 count, BlitMode mode) {
+    u64 word = offset / WORD_BITS, shift = offset % WORD_BITS;
+    u64 mask = low_bits(count);
+    value &= mask;
+    if (mode == BLIT_MODE_PASTE) {
+        row[word] &= ~(mask << shift);
+    }
+    row[word] |= value << shift;
+    if (shift != 0 && shift + count > WORD_BITS) {
+        if (mode == BLIT_MODE_PASTE) {
+            row[word + 1] &= ~(mask >> (WORD_BITS - shift));
+        }
+        row[word + 1] |= value >> (WORD_BITS - shift);
+    }
+}
+
+static inline i64 floor_div(i64 a, i64 b) {
+    i64 q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
 void Stage_init(Stage *stage) {
-    stage->width = MIN_LEVEL_WIDTH;
-    stage->height = MIN_LEVEL_HEIGHT;
-    stage->tiles = malloc(sizeof(bool) * stage->width * stage->height);
-    memset(stage->tiles, 0, sizeof(bool) * stage->width * stage->height);
+    Stage_alloc(stage, MIN_LEVEL_WIDTH, MIN_LEVEL_HEIGHT);
+}
+
+/**
+ * Allocate an empty `width` x `height` stage surrounded by a solid border.
+ */
+void Stage_alloc(Stage *stage, u64 width, u64 height) {
+    stage->width = width;
+    stage->height = height;
+    stage->stride = 2 * (STAGE_BORDER_COLS / WORD_BITS) + words_for(width);
+    size_t storage_size = sizeof(u64) * stage->stride * (height + 2 * STAGE_BORDER_ROWS);
+    stage->storage = malloc(storage_size);
+    memset(stage->storage, 0, storage_size);
+    stage->tiles = stage->storage
+        + STAGE_BORDER_ROWS * stage->stride
+        + STAGE_BORDER_COLS / WORD_BITS;
+    stage->masks = malloc(sizeof(u8) * width * height);
+    memset(stage->masks, 0, sizeof(u8) * width * height);
+    Stage_set_border(stage, true);
 }
 
 void Stage_destroy(Stage *stage) {
-    free(stage->tiles);
+    free(stage->storage);
+    free(stage->masks);
+    stage->storage = NULL;
+    stage->tiles = NULL;
+    stage->masks = NULL;
+}
+
+/**
+ * Neighbour mask of an in-bounds tile. Neighbours outside of the stage are
+ * read from the sentinel tiles.
+ */
+static inline u8 Stage_compute_mask(const Stage *stage, u64 col, u64 row) {
+    const u64 *middle_row = stage->storage + (row + STAGE_BORDER_ROWS) * stage->stride;
+    u64 padded_col = col + STAGE_BORDER_COLS - 1;
+    // 3 bits each: west, the tile's own column and east
+    u64 above = read_bits(middle_row - stage->stride, padded_col, 3);
+    u64 middle = read_bits(middle_row, padded_col, 3);
+    u64 below = read_bits(middle_row + stage->stride, padded_col, 3);
+    return above | (middle & 1) << 3 | (middle >> 2) << 4 | below << 5;
+}
+
+/**
+ * Recompute the neighbour masks of tiles from (first_col, first_row) to
+ * (last_col, last_row), inclusive. The rectangle is clipped to the stage.
+ */
+static void Stage_update_masks(
+    Stage *stage, i64 first_col, i64 first_row, i64 last_col, i64 last_row
+) {
+    if (first_col < 0) { first_col = 0; }
+    if (first_row < 0) { first_row = 0; }
+    if (last_col >= (i64)stage->width) { last_col = stage->width - 1; }
+    if (last_row >= (i64)stage->height) { last_row = stage->height - 1; }
+    for (i64 r = first_row; r <= last_row; r++) {
+        u8 *masks = stage->masks + r * stage->width;
+        for (i64 c = first_col; c <= last_col; c++) {
+            masks[c] = Stage_compute_mask(stage, c, r);
+        }
+    }
+}
+
+/**
+ * Fill the sentinel tiles around the stage with `border`.
+ */
+void Stage_set_border(Stage *stage, bool border) {
+    stage->border = border;
+    u64 fill = border ? ~(u64)0 : 0;
+    u64 padded_height = stage->height + 2 * STAGE_BORDER_ROWS;
+    u64 border_words = STAGE_BORDER_COLS / WORD_BITS;
+    u64 data_words = words_for(stage->width);
+    u64 tail_bits = stage->width % WORD_BITS;
+    for (u64 r = 0; r < padded_height; r++) {
+        u64 *row = stage->storage + r * stage->stride;
+        if (r < STAGE_BORDER_ROWS || r >= stage->height + STAGE_BORDER_ROWS) {
+            for (u64 w = 0; w < stage->stride; w++) {
+                row[w] = fill;
+            }
+            continue;
+        }
+        for (u64 w = 0; w < border_words; w++) {
+            row[w] = fill;
+            row[stage->stride - 1 - w] = fill;
+        }
+        if (tail_bits != 0) {
+            u64 *last = row + border_words + data_words - 1;
+            *last = (*last & low_bits(tail_bits)) | (fill & ~low_bits(tail_bits));
+        }
+    }
+    // only the tiles along the edges see the border
+    i64 last_col = stage->width - 1, last_row = stage->height - 1;
+    Stage_update_masks(stage, 0, 0, last_col, 0);
+    Stage_update_masks(stage, 0, last_row, last_col, last_row);
+    Stage_update_masks(stage, 0, 0, 0, last_row);
+    Stage_update_masks(stage, last_col, 0, last_col, last_row);
 }
 
 void Stage_marshal(const Stage *stage, u8 *buffer) {
@@ -35,9 +180,13 @@ void Stage_marshal(const Stage *stage, u8 *buffer) {
     // height
     memcpy(buffer, &stage->height, sizeof(stage->height));
     buffer += sizeof(stage->height);
-    // tiles
-    memcpy(buffer, stage->tiles, sizeof(bool) * stage->width * stage->height);
-    buffer += sizeof(bool) * stage->width * stage->height;
+    // tiles, one byte per tile
+    for (u64 r = 0; r < stage->height; r++) {
+        const u64 *row = stage->tiles + r * stage->stride;
+        for (u64 c = 0; c < stage->width; c++) {
+            *buffer++ = get_bit(row, c);
+        }
+    }
 }
 
 void Stage_save(const Stage *stage, const char *filename) {
@@ -67,15 +216,22 @@ void Stage_unmarshal(Stage *stage, const u8 *buffer) {
     }
     buffer += sizeof(version);
     // width
-    memcpy(&stage->width, buffer, sizeof(stage->width));
-    buffer += sizeof(stage->width);
+    u64 width;
+    memcpy(&width, buffer, sizeof(width));
+    buffer += sizeof(width);
     // height
-    memcpy(&stage->height, buffer, sizeof(stage->height));
-    buffer += sizeof(stage->height);
-    // tiles
-    size_t tiles_size = sizeof(bool) * stage->width * stage->height;
-    memcpy(stage->tiles, buffer, tiles_size);
-    buffer += tiles_size;
+    u64 height;
+    memcpy(&height, buffer, sizeof(height));
+    buffer += sizeof(height);
+    // tiles, one byte per tile
+    Stage_alloc(stage, width, height);
+    for (u64 r = 0; r < height; r++) {
+        u64 *row = stage->tiles + r * stage->stride;
+        for (u64 c = 0; c < width; c++) {
+            set_bit(row, c, *buffer++);
+        }
+    }
+    Stage_update_masks(stage, 0, 0, width - 1, height - 1);
 }
 
 void Stage_load(Stage *stage, const char *filename) {
@@ -102,7 +258,6 @@ void Stage_load(Stage *stage, const char *filename) {
         buff += sizeof(height);
 
         size_t tiles_size = sizeof(bool) * width * height;
-        stage->tiles = malloc(sizeof(bool) * width * height);
 
         size_t buffer_size = sizeof(peek_buffer) + tiles_size;
         u8 *buffer = malloc(buffer_size);
@@ -118,41 +273,217 @@ void Stage_load(Stage *stage, const char *filename) {
     }
 }
 
-void Stage_draw(Stage *stage, SDL_ScaledRenderer scaled_renderer) {
-    for (size_t r = 0; r < stage->height; r++) {
-        for (size_t c = 0; c < stage->width; c++) {
-            if (!stage->tiles[r * stage->width + c]) {
-                continue;
+#define ATLAS_COLUMNS 16
+
+/**
+ * Create a texture with a variant of the tile for every neighbour mask. The
+ * cell for mask `m` is at column `m % ATLAS_COLUMNS`, row `m / ATLAS_COLUMNS`.
+ * Edges facing empty tiles are highlighted, and so are the inner corners.
+ */
+SDL_Texture *TileAtlas_create(SDL_Renderer *renderer) {
+    int size = ATLAS_COLUMNS * TILE_SIZE;
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(
+        0, size, size, 32, SDL_PIXELFORMAT_RGBA8888
+    );
+    if (surface == NULL) { SDL_fail(); }
+    u32 fill = SDL_MapRGBA(surface->format, 0, 128, 0, 255);
+    u32 edge = SDL_MapRGBA(surface->format, 0, 200, 0, 255);
+    for (int mask = 0; mask < 256; mask++) {
+        int x = (mask % ATLAS_COLUMNS) * TILE_SIZE, y = (mask / ATLAS_COLUMNS) * TILE_SIZE;
+        SDL_Rect cell = {x, y, TILE_SIZE, TILE_SIZE};
+        SDL_FillRect(surface, &cell, fill);
+        SDL_Rect edges[] = {
+            {x, y, TILE_SIZE, 1},
+            {x, y + TILE_SIZE - 1, TILE_SIZE, 1},
+            {x, y, 1, TILE_SIZE},
+            {x + TILE_SIZE - 1, y, 1, TILE_SIZE},
+        };
+        Neighbour edge_neighbours[] = {NEIGHBOUR_N, NEIGHBOUR_S, NEIGHBOUR_W, NEIGHBOUR_E};
+        for (int i = 0; i < 4; i++) {
+            if (!(mask & edge_neighbours[i])) {
+                SDL_FillRect(surface, &edges[i], edge);
+            }
+        }
+        SDL_Rect corners[] = {
+            {x, y, 1, 1},
+            {x + TILE_SIZE - 1, y, 1, 1},
+            {x, y + TILE_SIZE - 1, 1, 1},
+            {x + TILE_SIZE - 1, y + TILE_SIZE - 1, 1, 1},
+        };
+        Neighbour corner_neighbours[][3] = {
+            {NEIGHBOUR_NW, NEIGHBOUR_N, NEIGHBOUR_W},
+            {NEIGHBOUR_NE, NEIGHBOUR_N, NEIGHBOUR_E},
+            {NEIGHBOUR_SW, NEIGHBOUR_S, NEIGHBOUR_W},
+            {NEIGHBOUR_SE, NEIGHBOUR_S, NEIGHBOUR_E},
+        };
+        for (int i = 0; i < 4; i++) {
+            Neighbour *n = corner_neighbours[i];
+            if (!(mask & n[0]) && (mask & n[1]) && (mask & n[2])) {
+                SDL_FillRect(surface, &corners[i], edge);
+            }
+        }
+    }
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_FreeSurface(surface);
+    if (texture == NULL) { SDL_fail(); }
+    return texture;
+}
+
+void Stage_draw(
+    Stage *stage,
+    SDL_ScaledRenderer scaled_renderer,
+    Camera camera,
+    SDL_Texture *tile_atlas
+) {
+    // only the tiles that are (at least partially) on the screen
+    i64 first_col = floor_div(camera.x, TILE_SIZE);
+    i64 first_row = floor_div(camera.y, TILE_SIZE);
+    i64 last_col = floor_div(camera.x + SCREEN_WIDTH - 1, TILE_SIZE);
+    i64 last_row = floor_div(camera.y + SCREEN_HEIGHT - 1, TILE_SIZE);
+    if (first_col < 0) { first_col = 0; }
+    if (first_row < 0) { first_row = 0; }
+    if (last_col >= (i64)stage->width) { last_col = stage->width - 1; }
+    if (last_row >= (i64)stage->height) { last_row = stage->height - 1; }
+    if (first_col > last_col || first_row > last_row) { return; }
+
+    for (i64 r = first_row; r <= last_row; r++) {
+        const u64 *row = stage->tiles + r * stage->stride;
+        const u8 *masks = stage->masks + r * stage->width;
+        for (i64 w = first_col / WORD_BITS; w <= last_col / WORD_BITS; w++) {
+            u64 bits = row[w];
+            if (w == first_col / WORD_BITS) {
+                bits &= ~low_bits(first_col % WORD_BITS);
+            }
+            if (w == last_col / WORD_BITS) {
+                bits &= low_bits(last_col % WORD_BITS + 1);
+            }
+            // visit only the solid tiles
+            for (; bits != 0; bits &= bits - 1) {
+                i64 c = w * WORD_BITS + __builtin_ctzll(bits);
+                SDL_Rect src = {
+                    .x = (masks[c] % ATLAS_COLUMNS) * TILE_SIZE,
+                    .y = (masks[c] / ATLAS_COLUMNS) * TILE_SIZE,
+                    .w = TILE_SIZE,
+                    .h = TILE_SIZE
+                };
+                SDL_Rect dst = {
+                    .x = c * TILE_SIZE - camera.x,
+                    .y = r * TILE_SIZE - camera.y,
+                    .w = TILE_SIZE,
+                    .h = TILE_SIZE
+                };
+                SDL_ScaledRenderCopy(scaled_renderer, tile_atlas, &src, &dst);
             }
-            SDL_Rect outer_rect = {
-                .x = c * TILE_SIZE,
-                .y = r * TILE_SIZE,
-                .w = TILE_SIZE,
-                .h = TILE_SIZE
-            };
-            SDL_SetRenderDrawColor(scaled_renderer.renderer, 0, 200, 0, 255);
-            SDL_ScaledRenderFillRect(scaled_renderer, &outer_rect);
-            SDL_Rect inner_rect = {
-                .x = outer_rect.x + 1,
-                .y = outer_rect.y + 1,
-                .w = outer_rect.w - 2,
-                .h = outer_rect.h - 2};
-            SDL_SetRenderDrawColor(scaled_renderer.renderer, 0, 128, 0, 255);
-            SDL_ScaledRenderFillRect(scaled_renderer, &inner_rect);
         }
     }
 }
 
-bool *Stage_tile_at(const Stage *stage, i32 x, i32 y) {
-    if (x > SCREEN_WIDTH || y > SCREEN_HEIGHT) {
-        return NULL;
+/**
+ * Get a tile by its column and row. Anything outside of the stage reads
+ * as the border.
+ */
+bool Stage_get_tile(const Stage *stage, i64 col, i64 row) {
+    if (col < 0 || row < 0 || (u64)col >= stage->width || (u64)row >= stage->height) {
+        return stage->border;
     }
-    size_t row = (f32)y / TILE_SIZE;
-    size_t col = (f32)x / TILE_SIZE;
-    if (row > stage->height || col > stage->width) {
-        return NULL;
+    return get_bit(stage->tiles + row * stage->stride, col);
+}
+
+/**
+ * Set a tile by its column and row. Returns false, without modifying
+ * anything, when the tile is outside of the stage.
+ */
+bool Stage_set_tile(Stage *stage, i64 col, i64 row, bool value) {
+    if (col < 0 || row < 0 || (u64)col >= stage->width || (u64)row >= stage->height) {
+        return false;
+    }
+    set_bit(stage->tiles + row * stage->stride, col, value);
+    Stage_update_masks(stage, col - 1, row - 1, col + 1, row + 1);
+    return true;
+}
+
+/**
+ * Get the tile under the point (x, y) given in pixels. Safe to call with
+ * any coordinates, see `Stage_get_tile`.
+ */
+bool Stage_tile_at(const Stage *stage, i32 x, i32 y) {
+    return Stage_get_tile(stage, floor_div(x, TILE_SIZE), floor_div(y, TILE_SIZE));
+}
+
+/**
+ * Set the tile under the point (x, y) given in pixels, see `Stage_set_tile`.
+ */
+bool Stage_set_tile_at(Stage *stage, i32 x, i32 y, bool value) {
+    return Stage_set_tile(stage, floor_div(x, TILE_SIZE), floor_div(y, TILE_SIZE), value);
+}
+
+/**
+ * Count the solid tiles among `count` tiles of `row` starting at `col`.
+ * The range must be inside of the stage.
+ */
+u64 Stage_count_tiles(const Stage *stage, u64 row, u64 col, u64 count) {
+    const u64 *bits = stage->tiles + row * stage->stride;
+    u64 total = 0;
+    for (u64 done = 0; done < count; done += WORD_BITS) {
+        u64 chunk = count - done < WORD_BITS ? count - done : WORD_BITS;
+        total += __builtin_popcountll(read_bits(bits, col + done, chunk));
+    }
+    return total;
+}
+
+/**
+ * Read `count` (at most 64) tiles of `row` starting at `col` as bits. Works
+ * for any coordinates: tiles outside of the stage read as `stage->border`,
+ * which is solid unless changed with `Stage_set_border`. Runs inside of the
+ * sentinel padding read it directly, the padding is filled with the border
+ * value, runs further out fall back to `Stage_get_tile`.
+ */
+u64 Stage_read_tiles(const Stage *stage, i64 row, i64 col, u64 count) {
+    bool row_inside = row >= -STAGE_BORDER_ROWS && row < (i64)stage->height + STAGE_BORDER_ROWS;
+    i64 padded_col = col + STAGE_BORDER_COLS;
+    if (row_inside && padded_col >= 0 && padded_col + count <= stage->stride * WORD_BITS) {
+        const u64 *padded_row = stage->storage + (row + STAGE_BORDER_ROWS) * stage->stride;
+        return read_bits(padded_row, padded_col, count);
+    }
+    u64 bits = 0;
+    for (u64 i = 0; i < count; i++) {
+        bits |= (u64)Stage_get_tile(stage, col + i, row) << i;
+    }
+    return bits;
+}
+
+/**
+ * Set `count` tiles of `row` starting at `col` to `value`. Returns false (and
+ * changes nothing) if the run is not inside of the stage.
+ */
+bool Stage_fill_tiles(Stage *stage, i64 row, i64 col, u64 count, bool value) {
+    if (col < 0 || row < 0 || (u64)row >= stage->height || (u64)col + count > stage->width) {
+        return false;
+    }
+    u64 *bits = stage->tiles + row * stage->stride;
+    for (u64 done = 0; done < count; done += WORD_BITS) {
+        u64 chunk = count - done < WORD_BITS ? count - done : WORD_BITS;
+        write_bits(bits, col + done, value ? ~(u64)0 : 0, chunk, BLIT_MODE_PASTE);
     }
-    return stage->tiles + (row * stage->width + col);
+    Stage_update_masks(stage, col - 1, row - 1, col + count, row + 1);
+    return true;
+}
+
+/**
+ * Collision probe used by the physics. Coordinates are moved into the padded
+ * space (so that the border starts at 0) and clamped onto the sentinel ring,
+ * which makes every lookup valid without branching on the stage bounds.
+ */
+static inline bool Stage_solid_at(const Stage *stage, i32 x, i32 y) {
+    i64 col = ((i64)x + STAGE_BORDER_COLS * TILE_SIZE) / TILE_SIZE;
+    i64 row = ((i64)y + STAGE_BORDER_ROWS * TILE_SIZE) / TILE_SIZE;
+    i64 max_col = stage->stride * WORD_BITS - 1;
+    i64 max_row = stage->height + 2 * STAGE_BORDER_ROWS - 1;
+    col = col < 0 ? 0 : col;
+    col = col > max_col ? max_col : col;
+    row = row < 0 ? 0 : row;
+    row = row > max_row ? max_row : row;
+    return (stage->storage[row * stage->stride + (col >> 6)] >> (col & 63)) & 1;
 }
 
 SDL_Rect Stage_rect_at(const Stage *stage, i32 x, i32 y) {
@@ -166,28 +497,127 @@ SDL_Rect Stage_rect_at(const Stage *stage, i32 x, i32 y) {
     };
 }
 
-void show_grid(SDL_ScaledRenderer scaled_renderer) {
+void show_grid(SDL_ScaledRenderer scaled_renderer, Camera camera) {
     SDL_SetRenderDrawColor(scaled_renderer.renderer, 210, 70, 148, 255);
-    SDL_ScaledRenderDrawLine(scaled_renderer, 0, 0, 0, SCREEN_HEIGHT);
-    for (int x = TILE_SIZE; x <= SCREEN_WIDTH; x += TILE_SIZE) {
+    int first_x = -(camera.x - floor_div(camera.x, TILE_SIZE) * TILE_SIZE);
+    int first_y = -(camera.y - floor_div(camera.y, TILE_SIZE) * TILE_SIZE);
+    for (int x = first_x; x <= SCREEN_WIDTH; x += TILE_SIZE) {
         SDL_ScaledRenderDrawLine(scaled_renderer, x - 1, 0, x - 1, SCREEN_HEIGHT);
         SDL_ScaledRenderDrawLine(scaled_renderer, x, 0, x, SCREEN_HEIGHT);
     }
-    SDL_ScaledRenderDrawLine(scaled_renderer, 0, 0, SCREEN_WIDTH, 0);
-    for (int y = TILE_SIZE; y <= SCREEN_HEIGHT; y += TILE_SIZE) {
+    for (int y = first_y; y <= SCREEN_HEIGHT; y += TILE_SIZE) {
         SDL_ScaledRenderDrawLine(scaled_renderer, 0, y - 1, SCREEN_WIDTH, y - 1);
         SDL_ScaledRenderDrawLine(scaled_renderer, 0, y, SCREEN_WIDTH, y);
     }
 }
 
+// Tile regions
+
+void TileRegion_destroy(TileRegion *region) {
+    free(region->bits);
+    region->bits = NULL;
+    region->width = region->height = region->stride = 0;
+}
+
+/**
+ * Clip the `width` x `height` rectangle at (col, row) to the stage. Returns
+ * false if nothing is left. `skip_cols` and `skip_rows` receive the number of
+ * columns and rows cut off at the left and top.
+ */
+static bool Stage_clip(
+    const Stage *stage, i64 *col, i64 *row, u64 *width, u64 *height,
+    u64 *skip_cols, u64 *skip_rows
+) {
+    *skip_cols = *col < 0 ? -*col : 0;
+    *skip_rows = *row < 0 ? -*row : 0;
+    if (*skip_cols >= *width || *skip_rows >= *height) {
+        return false;
+    }
+    *col += *skip_cols;
+    *row += *skip_rows;
+    *width -= *skip_cols;
+    *height -= *skip_rows;
+    if ((u64)*col >= stage->width || (u64)*row >= stage->height) {
+        return false;
+    }
+    if (*col + *width > stage->width) { *width = stage->width - *col; }
+    if (*row + *height > stage->height) { *height = stage->height - *row; }
+    return true;
+}
+
+/**
+ * Copy the `width` x `height` block of tiles at (col, row) into `region`,
+ * replacing its previous content. The block is clipped to the stage. Rows
+ * are copied a word at a time.
+ */
+void Stage_copy_region(
+    const Stage *stage, i64 col, i64 row, u64 width, u64 height, TileRegion *region
+) {
+    TileRegion_destroy(region);
+    u64 skip_cols, skip_rows;
+    if (!Stage_clip(stage, &col, &row, &width, &height, &skip_cols, &skip_rows)) {
+        return;
+    }
+    region->width = width;
+    region->height = height;
+    region->stride = words_for(width);
+    region->bits = malloc(sizeof(u64) * region->stride * height);
+    for (u64 r = 0; r < height; r++) {
+        const u64 *src = stage->tiles + (row + r) * stage->stride;
+        u64 *dst = region->bits + r * region->stride;
+        for (u64 w = 0; w < region->stride; w++) {
+            u64 count = width - w * WORD_BITS;
+            dst[w] = read_bits(src, col + w * WORD_BITS, count < WORD_BITS ? count : WORD_BITS);
+        }
+    }
+}
+
+/**
+ * Blit `region` onto the stage with its top left corner at (col, row).
+ * Parts of the region outside of the stage are skipped. Each row is written
+ * a word at a time, shifted into place and masked at both ends.
+ */
+void Stage_blit_region(Stage *stage, const TileRegion *region, i64 col, i64 row, BlitMode mode) {
+    u64 width = region->width, height = region->height;
+    u64 skip_cols, skip_rows;
+    if (!Stage_clip(stage, &col, &row, &width, &height, &skip_cols, &skip_rows)) {
+        return;
+    }
+    for (u64 r = 0; r < height; r++) {
+        const u64 *src = region->bits + (skip_rows + r) * region->stride;
+        u64 *dst = stage->tiles + (row + r) * stage->stride;
+        for (u64 done = 0; done < width; done += WORD_BITS) {
+            u64 count = width - done < WORD_BITS ? width - done : WORD_BITS;
+            u64 bits = read_bits(src, skip_cols + done, count);
+            write_bits(dst, col + done, bits, count, mode);
+        }
+    }
+    Stage_update_masks(stage, col - 1, row - 1, col + width, row + height);
+}
+
 // Player
 
-void Player_render(Player player, SDL_ScaledRenderer scaled_renderer) {
+/**
+ * The player `t` (0 to 1) of the way from one physics step to the next, to
+ * draw it between steps.
+ */
+Player Player_interpolate(Player from, Player to, f32 t) {
+    if (!from.show || !to.show) { return to; }
+    return (Player){
+        .x = from.x + (to.x - from.x) * t,
+        .y = from.y + (to.y - from.y) * t,
+        .dx = to.dx,
+        .dy = to.dy,
+        .show = true
+    };
+}
+
+void Player_render(Player player, SDL_ScaledRenderer scaled_renderer, Camera camera) {
     if (!player.show) { return; }
     SDL_SetRenderDrawColor(scaled_renderer.renderer, 0, 128, 0, 255);
     SDL_Rect rect = {
-        .x = player.x,
-        .y = player.y + 1,
+        .x = player.x - camera.x,
+        .y = player.y + 1 - camera.y,
         .w = PLAYER_SIZE,
         .h = PLAYER_SIZE
     };
@@ -196,29 +626,29 @@ void Player_render(Player player, SDL_ScaledRenderer scaled_renderer) {
 
 bool Player_collides_above(Player player, const Stage *stage) {
     return (
-        *Stage_tile_at(stage, roundf(player.x + 2), roundf(player.y))
-        || *Stage_tile_at(stage, roundf(player.x + PLAYER_SIZE - 2), roundf(player.y))
+        Stage_solid_at(stage, roundf(player.x + 2), roundf(player.y))
+        || Stage_solid_at(stage, roundf(player.x + PLAYER_SIZE - 2), roundf(player.y))
     );
 }
 
 bool Player_collides_below(Player player, const Stage *stage) {
     return (
-        *Stage_tile_at(stage, roundf(player.x + 2), roundf(player.y + PLAYER_SIZE))
-        || *Stage_tile_at(stage, roundf(player.x + PLAYER_SIZE - 2), roundf(player.y + PLAYER_SIZE))
+        Stage_solid_at(stage, roundf(player.x + 2), roundf(player.y + PLAYER_SIZE))
+        || Stage_solid_at(stage, roundf(player.x + PLAYER_SIZE - 2), roundf(player.y + PLAYER_SIZE))
     );
 }
 
 bool Player_collides_right(Player player, const Stage *stage) {
     return (
-        *Stage_tile_at(stage, roundf(player.x + PLAYER_SIZE - 1), roundf(player.y + 1))
-        || *Stage_tile_at(stage, roundf(player.x + PLAYER_SIZE - 1), roundf(player.y + PLAYER_SIZE - 1))
+        Stage_solid_at(stage, roundf(player.x + PLAYER_SIZE - 1), roundf(player.y + 1))
+        || Stage_solid_at(stage, roundf(player.x + PLAYER_SIZE - 1), roundf(player.y + PLAYER_SIZE - 1))
     );
 }
 
 bool Player_collides_left(Player player, const Stage *stage) {
     return (
-        *Stage_tile_at(stage, roundf(player.x - 1), roundf(player.y + 1))
-        || *Stage_tile_at(stage, roundf(player.x - 1), roundf(player.y + PLAYER_SIZE - 1))
+        Stage_solid_at(stage, roundf(player.x - 1), roundf(player.y + 1))
+        || Stage_solid_at(stage, roundf(player.x - 1), roundf(player.y + PLAYER_SIZE - 1))
     );
 }
 
@@ -235,14 +665,11 @@ void Player_update(Player *player, const Stage *stage, u32 ticks, InputState inp
                 player->dy = MAX_DY;
             }
             player->y += player->dy;
-            if (player->y > SCREEN_HEIGHT) { player->dy = 0; }
-            if (player->y >= 0 && player->y + PLAYER_SIZE <= SCREEN_HEIGHT) {
-                if (Player_collides_below(*player, stage)) {
-                    player->dy = 0;
-                }
-                if (Player_collides_above(*player, stage)) {
-                    player->dy = 0;
-                }
+            if (Player_collides_below(*player, stage)) {
+                player->dy = 0;
+            }
+            if (Player_collides_above(*player, stage)) {
+                player->dy = 0;
             }
             if (input_state.left_down && !Player_collides_left(*player, stage)) {
                 player->dx = fmax(player->dx - SIDE_MOVEMENT_SPEED, -SIDE_MOVEMENT_SPEED);
@@ -7,22 +7,97 @@
 #include "input_state.h"
 #include "types.h"
 
+// Sentinel tiles surrounding the stage: one word of tiles on both sides
+// of every row and a full row above and below the stage.
+#define STAGE_BORDER_COLS 64
+#define STAGE_BORDER_ROWS 1
+
+// Bits of a tile's neighbour mask, set when the neighbour is solid.
+typedef enum {
+    NEIGHBOUR_NW = 1 << 0,
+    NEIGHBOUR_N = 1 << 1,
+    NEIGHBOUR_NE = 1 << 2,
+    NEIGHBOUR_W = 1 << 3,
+    NEIGHBOUR_E = 1 << 4,
+    NEIGHBOUR_SW = 1 << 5,
+    NEIGHBOUR_S = 1 << 6,
+    NEIGHBOUR_SE = 1 << 7
+} Neighbour;
+
+/**
+ * Tiles are stored as bits, row by row, 64 tiles per word. Rows are padded
+ * with sentinel tiles so that collision probes never need to check bounds.
+ * `tiles` points at the word holding the first in-bounds tile, rows are
+ * `stride` words apart. Bits past `width` in the last word of a row belong
+ * to the border.
+ *
+ * `masks` holds the neighbour mask of every tile (`width` per row). It is
+ * kept up to date on every change and used to pick the tile's atlas cell.
+ */
 typedef struct {
     u64 width, height;
-    bool *tiles;
+    u64 stride;
+    bool border;  // value of the sentinel tiles, solid by default
+    u64 *storage;
+    u64 *tiles;
+    u8 *masks;
 } Stage;
 
+/**
+ * Rectangular block of tiles cut out of a stage, stored the same way as
+ * stage rows but without any border.
+ */
+typedef struct {
+    u64 width, height;
+    u64 stride;
+    u64 *bits;
+} TileRegion;
+
+/**
+ * Position of the top left corner of the screen in stage pixels. When zoomed
+ * out, every screen pixel covers 2^zoom x 2^zoom stage pixels.
+ */
+typedef struct {
+    i32 x, y;
+    u32 zoom;
+} Camera;
+
+typedef enum {
+    BLIT_MODE_PASTE, // replace the destination tiles
+    BLIT_MODE_STAMP  // only add the solid tiles of the region
+} BlitMode;
+
 
 void Stage_init(Stage *stage);
+void Stage_alloc(Stage *stage, u64 width, u64 height);
+void Stage_set_border(Stage *stage, bool border);
 void Stage_destroy(Stage *stage);
 void Stage_marshal(const Stage *stage, u8 *buffer);
 void Stage_save(const Stage *stage, const char *filename);
 void Stage_unmarshal(Stage *stage, const u8 *buffer);
 void Stage_load(Stage *stage, const char *filename);
-void Stage_draw(Stage *stage, SDL_ScaledRenderer scaled_renderer);
-bool *Stage_tile_at(const Stage *stage, i32 x, i32 y);
+SDL_Texture *TileAtlas_create(SDL_Renderer *renderer);
+void Stage_draw(
+    Stage *stage,
+    SDL_ScaledRenderer scaled_renderer,
+    Camera camera,
+    SDL_Texture *tile_atlas
+);
+bool Stage_get_tile(const Stage *stage, i64 col, i64 row);
+bool Stage_set_tile(Stage *stage, i64 col, i64 row, bool value);
+bool Stage_tile_at(const Stage *stage, i32 x, i32 y);
+bool Stage_set_tile_at(Stage *stage, i32 x, i32 y, bool value);
+u64 Stage_count_tiles(const Stage *stage, u64 row, u64 col, u64 count);
+u64 Stage_read_tiles(const Stage *stage, i64 row, i64 col, u64 count);
+bool Stage_fill_tiles(Stage *stage, i64 row, i64 col, u64 count, bool value);
 SDL_Rect Stage_rect_at(const Stage *stage, i32 x, i32 y);
-void show_grid(SDL_ScaledRenderer scaled_renderer);
+void show_grid(SDL_ScaledRenderer scaled_renderer, Camera camera);
+
+void TileRegion_destroy(TileRegion *region);
+void Stage_copy_region(
+    const Stage *stage, i64 col, i64 row, u64 width, u64 height, TileRegion *region
+);
+void Stage_blit_region(Stage *stage, const TileRegion *region, i64 col, i64 row, BlitMode mode);
 
 typedef struct {
     f32 x, y;
@@ -30,7 +105,8 @@ typedef struct {
     bool show;
 } Player;
 
-void Player_render(Player player, SDL_ScaledRenderer scaled_renderer);
+Player Player_interpolate(Player from, Player to, f32 t);
+void Player_render(Player player, SDL_ScaledRenderer scaled_renderer, Camera camera);
 bool Player_collides_above(Player player, const Stage *stage);
 bool Player_collides_below(Player player, const Stage *stage);
 bool Player_collides_right(Player player, const Stage *stage);
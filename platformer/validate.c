@@ -0,0 +1,426 @@
+/**
+ * Checks which parts of a stage the player can reach, following the exact
+ * rules of `Player_update`.
+ *
+ *     ./validate stage.bin [start_col start_row [goal_col goal_row goal_w goal_h]]
+ *     ./validate stages/
+ *
+ * The player state is sampled once per frame (`FRAME_TICKS`). From every
+ * state, each combination of inputs held for one frame leads to a new state.
+ * States are deduplicated on a grid of (position, vertical speed) cells and
+ * explored breadth first, one frame at a time, on all cores. The cells are as
+ * coarse as they can be while a walking player still leaves its cell every
+ * frame: finer cells multiply the states of every jump for about 1% more of
+ * the stage reached. The visited cells are kept in an atomic bitset of
+ * `BLOCK_WORDS` words per tile.
+ * By default the player starts on the lowest free tile of the leftmost
+ * column.
+ */
+#include <SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "input_state.h"
+#include "playlist.h"
+#include "stage.h"
+#include "types.h"
+
+#define PLAYER_SIZE 20
+#define TILE_SIZE 40
+#define FRAME_TICKS 32
+// size of the cells states are deduplicated on, walking moves 12.8 pixels a frame
+#define CELL_PIXELS 10
+#define CELL_DY 0.25
+#define MIN_DY -1.2
+#define MAX_DY 0.5
+#define DY_CELLS ((u64)((MAX_DY - MIN_DY) / CELL_DY) + 1)
+// position cells along a tile side
+#define TILE_CELLS (TILE_SIZE / CELL_PIXELS)
+// words of the bitset of the state cells of one tile
+#define BLOCK_WORDS ((TILE_CELLS * TILE_CELLS * DY_CELLS + 63) / 64)
+
+#define ACTION_COUNT 6
+static const InputState actions[ACTION_COUNT] = {
+    {.left_down = false, .right_down = false, .space_down = false},
+    {.left_down = true, .right_down = false, .space_down = false},
+    {.left_down = false, .right_down = true, .space_down = false},
+    {.left_down = false, .right_down = false, .space_down = true},
+    {.left_down = true, .right_down = false, .space_down = true},
+    {.left_down = false, .right_down = true, .space_down = true},
+};
+
+typedef struct {
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    int count, waiting;
+    u64 generation;
+} Barrier;
+
+static void Barrier_init(Barrier *barrier, int count) {
+    barrier->mutex = SDL_CreateMutex();
+    barrier->cond = SDL_CreateCond();
+    barrier->count = count;
+    barrier->waiting = 0;
+    barrier->generation = 0;
+}
+
+static void Barrier_destroy(Barrier *barrier) {
+    SDL_DestroyCond(barrier->cond);
+    SDL_DestroyMutex(barrier->mutex);
+}
+
+static void Barrier_wait(Barrier *barrier) {
+    SDL_LockMutex(barrier->mutex);
+    u64 generation = barrier->generation;
+    if (++barrier->waiting == barrier->count) {
+        barrier->waiting = 0;
+        barrier->generation++;
+        SDL_CondBroadcast(barrier->cond);
+    } else {
+        while (generation == barrier->generation) {
+            SDL_CondWait(barrier->cond, barrier->mutex);
+        }
+    }
+    SDL_UnlockMutex(barrier->mutex);
+}
+
+/**
+ * Exit when an allocation failed, there is no way to go on with the search.
+ */
+static void *check_alloc(void *pointer, const char *what) {
+    if (pointer == NULL) {
+        printf("ERROR: out of memory for %s\n", what);
+        exit(1);
+    }
+    return pointer;
+}
+
+typedef struct {
+    Player *states;
+    size_t count, capacity;
+} StateList;
+
+static void StateList_push(StateList *list, Player state) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? 2 * list->capacity : 1024;
+        list->states = check_alloc(realloc(list->states, sizeof(Player) * list->capacity), "states");
+    }
+    list->states[list->count++] = state;
+}
+
+typedef struct {
+    const Stage *stage;
+    u64 cells_x, cells_y;
+    u64 *visited;         // BLOCK_WORDS words per tile, a bit per state cell
+    u64 *reached;         // one bit per tile the player has overlapped
+    SDL_Rect goal;        // in tiles, empty when w == 0
+    SDL_atomic_t goal_reached;
+    StateList frontier, next;
+    SDL_atomic_t next_chunk;
+    SDL_mutex *next_mutex;
+    Barrier barrier;
+    bool done;
+} Search;
+
+typedef struct {
+    Search *search;
+    StateList found;
+} Worker;
+
+static inline bool set_bit_atomic(u64 *bits, u64 i) {
+    u64 mask = (u64)1 << (i % 64);
+    return (__atomic_fetch_or(&bits[i / 64], mask, __ATOMIC_RELAXED) & mask) == 0;
+}
+
+/**
+ * Claim the cell of the state, returns false if it was already visited or the
+ * state is outside of the stage.
+ */
+static bool Search_visit(Search *search, Player state) {
+    if (state.x < 0 || state.y < 0) { return false; }
+    u64 cx = (u64)state.x / CELL_PIXELS, cy = (u64)state.y / CELL_PIXELS;
+    if (cx >= search->cells_x || cy >= search->cells_y) { return false; }
+    f64 dy = state.dy < MIN_DY ? MIN_DY : state.dy > MAX_DY ? MAX_DY : state.dy;
+    u64 cdy = (dy - MIN_DY) / CELL_DY;
+    const Stage *stage = search->stage;
+    u64 *bits = search->visited + (cy / TILE_CELLS * stage->width + cx / TILE_CELLS) * BLOCK_WORDS;
+    u64 cell = (cdy * TILE_CELLS + cy % TILE_CELLS) * TILE_CELLS + cx % TILE_CELLS;
+    if (!set_bit_atomic(bits, cell)) {
+        return false;
+    }
+
+    i64 first_col = (i64)state.x / TILE_SIZE, last_col = ((i64)state.x + PLAYER_SIZE - 1) / TILE_SIZE;
+    i64 first_row = (i64)state.y / TILE_SIZE, last_row = ((i64)state.y + PLAYER_SIZE - 1) / TILE_SIZE;
+    for (i64 row = first_row; row <= last_row && row < (i64)stage->height; row++) {
+        for (i64 col = first_col; col <= last_col && col < (i64)stage->width; col++) {
+            set_bit_atomic(search->reached, row * stage->width + col);
+        }
+    }
+    SDL_Rect goal = search->goal;
+    if (goal.w != 0
+        && last_col >= goal.x && first_col < goal.x + goal.w
+        && last_row >= goal.y && first_row < goal.y + goal.h) {
+        SDL_AtomicSet(&search->goal_reached, 1);
+    }
+    return true;
+}
+
+static void Search_expand(Search *search, Player state, StateList *found) {
+    bool grounded = Player_collides_below(state, search->stage);
+    for (int i = 0; i < ACTION_COUNT; i++) {
+        // jumping only does something when standing on the ground
+        if (actions[i].space_down && !grounded) { continue; }
+        Player next = state;
+        Player_update(&next, search->stage, FRAME_TICKS, actions[i]);
+        if (Search_visit(search, next)) {
+            StateList_push(found, next);
+        }
+    }
+}
+
+#define CHUNK_SIZE 64
+
+static int Search_worker(void *data) {
+    Worker *worker = data;
+    Search *search = worker->search;
+    while (true) {
+        Barrier_wait(&search->barrier);
+        if (search->done) { break; }
+        worker->found.count = 0;
+        while (true) {
+            size_t start = (size_t)SDL_AtomicAdd(&search->next_chunk, 1) * CHUNK_SIZE;
+            if (start >= search->frontier.count) { break; }
+            size_t end = start + CHUNK_SIZE < search->frontier.count ? start + CHUNK_SIZE : search->frontier.count;
+            for (size_t i = start; i < end; i++) {
+                Search_expand(search, search->frontier.states[i], &worker->found);
+            }
+        }
+        SDL_LockMutex(search->next_mutex);
+        for (size_t i = 0; i < worker->found.count; i++) {
+            StateList_push(&search->next, worker->found.states[i]);
+        }
+        SDL_UnlockMutex(search->next_mutex);
+        Barrier_wait(&search->barrier);
+    }
+    return 0;
+}
+
+/**
+ * Count the groups of connected free tiles the player never reached and
+ * return the size of the largest one.
+ */
+static u64 count_islands(const Stage *stage, const u64 *reached, u64 *islands, i64 *largest_col, i64 *largest_row) {
+    u64 tiles = stage->width * stage->height;
+    u8 *seen = check_alloc(calloc(tiles, sizeof(u8)), "islands");
+    u64 *stack = check_alloc(malloc(sizeof(u64) * tiles), "islands");
+    u64 largest = 0;
+    *islands = 0;
+    for (u64 i = 0; i < tiles; i++) {
+        if (seen[i] || (reached[i / 64] >> (i % 64)) & 1
+            || Stage_get_tile(stage, i % stage->width, i / stage->width)) {
+            continue;
+        }
+        u64 size = 0, top = 0;
+        stack[top++] = i;
+        seen[i] = true;
+        while (top > 0) {
+            u64 tile = stack[--top];
+            size++;
+            i64 col = tile % stage->width, row = tile / stage->width;
+            i64 neighbours[4][2] = {{col - 1, row}, {col + 1, row}, {col, row - 1}, {col, row + 1}};
+            for (int n = 0; n < 4; n++) {
+                i64 c = neighbours[n][0], r = neighbours[n][1];
+                if (c < 0 || r < 0 || c >= (i64)stage->width || r >= (i64)stage->height) { continue; }
+                u64 j = r * stage->width + c;
+                if (seen[j] || (reached[j / 64] >> (j % 64)) & 1 || Stage_get_tile(stage, c, r)) {
+                    continue;
+                }
+                seen[j] = true;
+                stack[top++] = j;
+            }
+        }
+        (*islands)++;
+        if (size > largest) {
+            largest = size;
+            *largest_col = i % stage->width;
+            *largest_row = i / stage->width;
+        }
+    }
+    free(stack);
+    free(seen);
+    return largest;
+}
+
+/**
+ * Lowest free tile of the leftmost column that has one, standing on a solid
+ * tile (or on the bottom of the stage).
+ */
+static bool default_start(const Stage *stage, i64 *start_col, i64 *start_row) {
+    for (i64 col = 0; col < (i64)stage->width; col++) {
+        for (i64 row = stage->height - 1; row >= 0; row--) {
+            if (!Stage_get_tile(stage, col, row)
+                && (row + 1 == (i64)stage->height || Stage_get_tile(stage, col, row + 1))) {
+                *start_col = col;
+                *start_row = row;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Validate one stage, returns false when the goal can not be reached.
+ */
+static bool validate(const char *file_name, i64 start_col, i64 start_row, SDL_Rect goal, int thread_count) {
+    u64 start_time = SDL_GetPerformanceCounter();
+    Stage stage;
+    Stage_load(&stage, file_name);
+    if (start_col < 0 && !default_start(&stage, &start_col, &start_row)) {
+        printf("%s: no free tile to start from\n", file_name);
+        Stage_destroy(&stage);
+        return false;
+    }
+
+    Search search = {
+        .stage = &stage,
+        .cells_x = stage.width * TILE_SIZE / CELL_PIXELS,
+        .cells_y = stage.height * TILE_SIZE / CELL_PIXELS,
+        .goal = goal,
+        .frontier = {NULL, 0, 0},
+        .next = {NULL, 0, 0},
+        .next_mutex = SDL_CreateMutex(),
+        .done = false
+    };
+    search.visited = check_alloc(calloc(stage.width * stage.height * BLOCK_WORDS, sizeof(u64)), "visited states");
+    search.reached = check_alloc(calloc((stage.width * stage.height + 63) / 64, sizeof(u64)), "reached tiles");
+    SDL_AtomicSet(&search.goal_reached, 0);
+    Barrier_init(&search.barrier, thread_count + 1);
+
+    Worker *workers = check_alloc(malloc(sizeof(Worker) * thread_count), "workers");
+    SDL_Thread **threads = check_alloc(malloc(sizeof(SDL_Thread *) * thread_count), "workers");
+    for (int i = 0; i < thread_count; i++) {
+        workers[i] = (Worker){.search = &search, .found = {NULL, 0, 0}};
+        threads[i] = SDL_CreateThread(Search_worker, "validate", &workers[i]);
+        if (threads[i] == NULL) { SDL_fail(); }
+    }
+
+    // standing on the bottom of the start tile
+    Player start = {
+        .x = start_col * TILE_SIZE + (TILE_SIZE - PLAYER_SIZE) / 2,
+        .y = (start_row + 1) * TILE_SIZE - PLAYER_SIZE,
+        .dx = 0,
+        .dy = 0,
+        .show = true
+    };
+    Search_visit(&search, start);
+    StateList_push(&search.frontier, start);
+    u64 states = 1, frames = 0, goal_frames = 0;
+    bool goal_reached = SDL_AtomicGet(&search.goal_reached);
+    while (search.frontier.count > 0) {
+        search.next.count = 0;
+        SDL_AtomicSet(&search.next_chunk, 0);
+        Barrier_wait(&search.barrier);  // start the frame
+        Barrier_wait(&search.barrier);  // wait for the workers
+        StateList frontier = search.frontier;
+        search.frontier = search.next;
+        search.next = frontier;
+        states += search.frontier.count;
+        frames++;
+        if (!goal_reached && SDL_AtomicGet(&search.goal_reached)) {
+            goal_reached = true;
+            goal_frames = frames;
+        }
+    }
+    search.done = true;
+    Barrier_wait(&search.barrier);
+    for (int i = 0; i < thread_count; i++) {
+        SDL_WaitThread(threads[i], NULL);
+        free(workers[i].found.states);
+    }
+
+    u64 free_tiles = 0, reached_tiles = 0;
+    for (u64 row = 0; row < stage.height; row++) {
+        for (u64 col = 0; col < stage.width; col++) {
+            u64 i = row * stage.width + col;
+            if (!Stage_get_tile(&stage, col, row)) {
+                free_tiles++;
+                reached_tiles += (search.reached[i / 64] >> (i % 64)) & 1;
+            }
+        }
+    }
+    u64 islands;
+    i64 island_col = 0, island_row = 0;
+    u64 largest_island = count_islands(&stage, search.reached, &islands, &island_col, &island_row);
+
+    printf(
+        "%s (%lux%lu) from (%ld, %ld): reached %lu/%lu free tiles (%.1f%%), ",
+        file_name, stage.width, stage.height, start_col, start_row,
+        reached_tiles, free_tiles, free_tiles ? 100. * reached_tiles / free_tiles : 100.
+    );
+    if (islands > 0) {
+        printf("%lu unreachable islands (largest: %lu tiles at (%ld, %ld)), ",
+               islands, largest_island, island_col, island_row);
+    } else {
+        printf("no unreachable islands, ");
+    }
+    if (goal.w != 0) {
+        if (goal_reached) {
+            printf("goal reached in %lu frames, ", goal_frames);
+        } else {
+            printf("goal NOT reachable, ");
+        }
+    }
+    printf(
+        "%lu states in %lu frames, %.1f MB of visited states, %.2f ms on %d threads\n",
+        states, frames,
+        (f64)stage.width * stage.height * BLOCK_WORDS * sizeof(u64) / (1 << 20),
+        (SDL_GetPerformanceCounter() - start_time) * 1000. / SDL_GetPerformanceFrequency(),
+        thread_count
+    );
+
+    Barrier_destroy(&search.barrier);
+    SDL_DestroyMutex(search.next_mutex);
+    free(threads);
+    free(workers);
+    free(search.frontier.states);
+    free(search.next.states);
+    free(search.visited);
+    free(search.reached);
+    Stage_destroy(&stage);
+    return goal.w == 0 || goal_reached;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2 && argc != 4 && argc != 8) {
+        printf("Usage: %s (stage.bin [start_col start_row [goal_col goal_row goal_w goal_h]] | dir)\n", argv[0]);
+        return 1;
+    }
+    i64 start_col = -1, start_row = -1;
+    SDL_Rect goal = {0, 0, 0, 0};
+    if (argc >= 4) {
+        start_col = atol(argv[2]);
+        start_row = atol(argv[3]);
+    }
+    if (argc == 8) {
+        goal = (SDL_Rect){atoi(argv[4]), atoi(argv[5]), atoi(argv[6]), atoi(argv[7])};
+    }
+    int thread_count = SDL_GetCPUCount();
+
+    struct stat path_stat;
+    if (stat(argv[1], &path_stat) == 0 && S_ISDIR(path_stat.st_mode)) {
+        char **file_names;
+        size_t count = Playlist_list_files(argv[1], &file_names);
+        bool ok = true;
+        for (size_t i = 0; i < count; i++) {
+            ok = validate(file_names[i], start_col, start_row, goal, thread_count) && ok;
+            free(file_names[i]);
+        }
+        free(file_names);
+        return ok ? 0 : 1;
+    }
+    return validate(argv[1], start_col, start_row, goal, thread_count) ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+# Validates a stage of the size ./generate makes by default (10000x1000) from
+# the middle of its main cave, and fails if it takes longer than the limit in
+# seconds (1800 by default, the search takes about 28 minutes on one core and
+# divides by the number of cores) or if the player reaches less than half of
+# the free tiles, which means the start is stuck and nothing was tested.
+LIMIT=${1:-1800}
+STAGE=$(mktemp)
+OUTPUT=$(mktemp)
+gcc generate.c generator.c SDL_utils.c stage.c \
+    -o generate \
+    -O2 -g \
+    -Wall -Wextra -Wunreachable-code \
+    `pkg-config --cflags --libs sdl2 SDL2_image SDL2_mixer SDL2_ttf` \
+    -DSDL_DISABLE_IMMINTRIN_H \
+    && gcc validate.c SDL_utils.c playlist.c stage.c \
+    -o validate \
+    -O2 -g \
+    -Wall -Wextra -Wunreachable-code \
+    `pkg-config --cflags --libs sdl2 SDL2_image SDL2_mixer SDL2_ttf` \
+    -DSDL_DISABLE_IMMINTRIN_H \
+    && ./generate "$STAGE" 10000 1000 1 \
+    && timeout "$LIMIT" ./validate "$STAGE" 5002 499 > "$OUTPUT"
+STATUS=$?
+cat "$OUTPUT"
+if [ $STATUS -eq 0 ]; then
+    PERCENT=$(sed -n 's/.*free tiles (\([0-9]*\)\..*/\1/p' "$OUTPUT")
+    if [ -z "$PERCENT" ] || [ "$PERCENT" -lt 50 ]; then
+        echo "validate reached too little of the stage to test anything"
+        STATUS=1
+    fi
+fi
+rm -f "$STAGE" "$OUTPUT"
+if [ $STATUS -eq 124 ]; then
+    echo "validate took longer than $LIMIT s"
+fi
+exit $STATUS
@@ -0,0 +1,7 @@
+gcc main.c \
+    -o spaceships \
+    -O2 \
+    -Wall -Wextra -Wunreachable-code \
+    `pkg-config --cflags --libs sdl2 SDL2_image SDL2_mixer` \
+    -DSDL_DISABLE_IMMINTRIN_H \
+    && ./spaceships --bench "$@"
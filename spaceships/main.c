@@ -1,45 +1,78 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_mixer.h>
+#include <fcntl.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define DEBUG 0
 
 /**
- * Max/target FPS. The game mechanics are frame dependent so changing
- * this parameter might require changing other parameters to preserve
- * the gameplay thempo. The game might not work as expected when
- * the MAX_FPS is not actually reached.
+ * The game is simulated in fixed steps of 1/SIMULATION_RATE seconds, however
+ * fast the frames are rendered. Frames show the game between the last two
+ * steps. All speeds and delays below are in seconds.
  */
-#define MAX_FPS 60
+#define SIMULATION_RATE 120
+#define SIMULATION_STEP (1. / SIMULATION_RATE)
+// time not simulated yet is dropped past this, after a long frame
+#define MAX_SIMULATION_LAG 0.25
 
 #define SCREEN_WIDTH 480
 #define SCREEN_HEIGHT 960
 
+// format the sounds are mixed in
+#define AUDIO_FREQUENCY 44100
+#define AUDIO_FORMAT MIX_DEFAULT_FORMAT
+#define AUDIO_CHANNELS 2
+
 #define SPACESHIP_WIDTH 55
 #define SPACESHIP_HEIGHT (SPACESHIP_WIDTH * 1.05)
 
-// player spaceship speed (pixels/frame)
-#define PLAYER_SPEED 2
+// player spaceship speed (pixels/second)
+#define PLAYER_SPEED 120
 #define PLAYER_HEALTH 500
 
 #define BULLET_DAMAGE 35
-#define BULLET_SPEED 10
+// pixels/second
+#define BULLET_SPEED 600
 #define BULLET_WIDTH 8
 #define BULLET_HEIGHT (BULLET_WIDTH * 3.3)
-#define MAX_BULLETS_NUM 50
-#define RELOAD_TIME 30
+// seconds between two shots
+#define RELOAD_TIME 0.5
 
-// delay in frames between enemy spawnd
-#define SPAWN_DELAY 30
-// maximum number of enemies that spawn in one frame
+// delay in seconds between enemy spawns
+#define SPAWN_DELAY 0.5
+// maximum number of enemies that spawn at once
 #define MAX_SPAWN 1
 #define ENEMIES_COUNT 8
 #define ENEMY_HEALTH 100
+// pixels/second
+#define ENEMY_SPEED 60
+// how many times a second an enemy tries to shoot, on average
+#define ENEMY_FIRE_RATE 0.12
+
+// seconds for an explosion to grow to its largest size, where it ends
+#define EXPLOSION_PEAK_TIME 0.5
+
+/* Particles */
+#define MAX_PARTICLES 50000
+// part of their speed that particles lose every second
+#define PARTICLES_DRAG 1.5
+// particles for a bullet hit and a destroyed spaceship
+#define SPARKS_COUNT 12
+#define DEBRIS_COUNT 40
+// particles/second behind every spaceship
+#define ENGINE_TRAIL_RATE 90
 
 /* Stars */
-#define STARS_MAX_SPEED 3
+// pixels/second
+#define STARS_SPEED_STEP 60
+#define STARS_MAX_SPEED (3 * STARS_SPEED_STEP)
 #define STARS_COUNT 50
 
 /* Utilities */
@@ -58,6 +91,13 @@
 
 /*** SDL Utilities ***/
 
+/**
+ * Number of draw calls made so far, reported by the benchmark and shown when
+ * debugging. The draw call used by the game is wrapped to count them.
+ */
+static Uint64 draw_calls = 0;
+#define SDL_RenderGeometry(...) (draw_calls++, SDL_RenderGeometry(__VA_ARGS__))
+
 void sdl_fail() {
     printf("SDL ERROR: %s\n", SDL_GetError());
     exit(1);
@@ -81,7 +121,7 @@ void sdl_init(SDL_Window **window, SDL_Renderer **renderer) {
         sdl_fail();
     }
 
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 4096)) {
+    if (Mix_OpenAudio(AUDIO_FREQUENCY, AUDIO_FORMAT, AUDIO_CHANNELS, 4096)) {
         sdl_fail();
     }
 
@@ -94,7 +134,9 @@ void sdl_init(SDL_Window **window, SDL_Renderer **renderer) {
         sdl_fail();
     }
 
-    *renderer = SDL_CreateRenderer(*window, -1, SDL_RENDERER_ACCELERATED);
+    *renderer = SDL_CreateRenderer(
+        *window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC
+    );
     if (!*renderer) {
         sdl_fail();
     }
@@ -107,7 +149,7 @@ void sdl_destroy(SDL_Window *window, SDL_Renderer *renderer) {
     SDL_Quit();
 }
 
-/*** Texture Cache ***/
+/*** Texture Atlas ***/
 
 typedef enum {
     TEXTURE_FONT_KEN_PIXEL_WHITE,
@@ -115,78 +157,287 @@ typedef enum {
     TEXTURE_LASER,
     TEXTURE_FIREBALL,
     TEXTURE_SPACESHIP,
+    TEXTURE_SPACESHIP_TURNED, // facing down, for the enemies
+    TEXTURE_WHITE, // a white square, to draw plain colored shapes
     TEXTURE_END_MARKER // the number of available textures
 } TextureType;
 
-static char *TEXTURE_FILE_NAMES[TEXTURE_END_MARKER] = {
-    "assets/KenPixelWhite.png",
-    "assets/explosion.png",
-    "assets/laser.png",
-    "assets/fireball.png",
-    "assets/spaceship.png",
+typedef struct {
+    char *file_name; // NULL for TEXTURE_WHITE
+    bool turned; // rotated by 180 degrees
+} TextureSource;
+
+static TextureSource TEXTURE_SOURCES[TEXTURE_END_MARKER] = {
+    {"assets/KenPixelWhite.png", false},
+    {"assets/explosion.png", false},
+    {"assets/laser.png", false},
+    {"assets/fireball.png", false},
+    {"assets/spaceship.png", false},
+    {"assets/spaceship.png", true},
+    {NULL, false},
 };
 
+#define ATLAS_WIDTH 1024
+// transparent pixels around every texture in the atlas
+#define ATLAS_PADDING 1
+#define WHITE_TEXTURE_SIZE 4
+
 /**
- * Do not access these variables directly, use functions starting with 'TexturesCache'.
+ * All the textures are packed into a single one when the game starts, so
+ * that everything can be drawn at once by the sprite batch.
+ * Do not access these variables directly, use functions starting with 'TextureAtlas'.
  */
-static SDL_Texture *_textures_cache[TEXTURE_END_MARKER];
-static bool _textures_cache_initialized = false;
+static SDL_Texture *_atlas_texture = NULL;
+static int _atlas_width = 0, _atlas_height = 0;
+static SDL_Rect _atlas_rects[TEXTURE_END_MARKER]; // where every texture is in the atlas
 
 /**
- * Initialize the texture cache. It is called automatically on the first call to
- * `TexturesCache_get`.
+ * Load a texture as a surface of 32-bit RGBA pixels.
  */
-void TexturesCache_initialize() {
-    for (int i = 0; i < TEXTURE_END_MARKER; i++) {
-        _textures_cache[i] = NULL;
+SDL_Surface *load_texture_surface(TextureType texture_type) {
+    TextureSource source = TEXTURE_SOURCES[texture_type];
+    if (source.file_name == NULL) {
+        SDL_Surface *white = SDL_CreateRGBSurfaceWithFormat(
+            0, WHITE_TEXTURE_SIZE, WHITE_TEXTURE_SIZE, 32, SDL_PIXELFORMAT_RGBA32
+        );
+        if (white == NULL) {
+            sdl_fail();
+        }
+        memset(white->pixels, 0xff, white->pitch * white->h);
+        return white;
     }
-    _textures_cache_initialized = true;
+    SDL_Surface *loaded = IMG_Load(source.file_name);
+    if (loaded == NULL) {
+        sdl_fail();
+    }
+    SDL_Surface *surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(loaded);
+    if (surface == NULL) {
+        sdl_fail();
+    }
+    if (source.turned) {
+        SDL_Surface *turned = SDL_CreateRGBSurfaceWithFormat(
+            0, surface->w, surface->h, 32, SDL_PIXELFORMAT_RGBA32
+        );
+        if (turned == NULL) {
+            sdl_fail();
+        }
+        for (int y = 0; y < surface->h; y++) {
+            Uint32 *src = (Uint32 *)((Uint8 *)surface->pixels + y * surface->pitch);
+            Uint32 *dst = (Uint32 *)((Uint8 *)turned->pixels + (surface->h - 1 - y) * turned->pitch);
+            for (int x = 0; x < surface->w; x++) {
+                dst[surface->w - 1 - x] = src[x];
+            }
+        }
+        SDL_FreeSurface(surface);
+        surface = turned;
+    }
+    return surface;
 }
 
 /**
- * This function clears the cache. Make sure to call it before the program ends
- * so that all the textures can be destroyed.
+ * Load all the textures and pack them into an atlas surface, in rows from the
+ * tallest texture to the shortest. `rects` is set to where every texture is.
  */
-void TexturesCache_destroy() {
-    if (!_textures_cache_initialized) {
-        return;
+SDL_Surface *TextureAtlas_pack(SDL_Rect rects[TEXTURE_END_MARKER]) {
+    SDL_Surface *surfaces[TEXTURE_END_MARKER];
+    int order[TEXTURE_END_MARKER];
+    for (int i = 0; i < TEXTURE_END_MARKER; i++) {
+        surfaces[i] = load_texture_surface(i);
+        // insertion sort, tallest first
+        int j = i;
+        for (; j > 0 && surfaces[order[j - 1]]->h < surfaces[i]->h; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
     }
+
+    int x = ATLAS_PADDING, y = ATLAS_PADDING, row_height = 0;
     for (int i = 0; i < TEXTURE_END_MARKER; i++) {
-        if (_textures_cache[i] != NULL) {
-            SDL_DestroyTexture(_textures_cache[i]);
-            _textures_cache[i] = NULL;
+        SDL_Surface *surface = surfaces[order[i]];
+        if (x + surface->w + ATLAS_PADDING > ATLAS_WIDTH) {
+            x = ATLAS_PADDING;
+            y += row_height + ATLAS_PADDING;
+            row_height = 0;
         }
+        rects[order[i]] = (SDL_Rect){x, y, surface->w, surface->h};
+        x += surface->w + ATLAS_PADDING;
+        row_height = MAX(row_height, surface->h);
     }
-    _textures_cache_initialized = false;
+
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(
+        0, ATLAS_WIDTH, y + row_height + ATLAS_PADDING, 32, SDL_PIXELFORMAT_RGBA32
+    );
+    if (atlas == NULL) {
+        sdl_fail();
+    }
+    memset(atlas->pixels, 0, atlas->pitch * atlas->h);
+    for (int i = 0; i < TEXTURE_END_MARKER; i++) {
+        // copy the pixels as they are, alpha included
+        SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+        SDL_Rect rect = rects[i];
+        if (SDL_BlitSurface(surfaces[i], NULL, atlas, &rect) != 0) {
+            sdl_fail();
+        }
+        SDL_FreeSurface(surfaces[i]);
+    }
+    return atlas;
 }
 
 /**
- * Get a texture by `TextureType`. Textures cache will be initialized if was not
- * already initialized.
+ * Create the atlas texture from a surface packed by `TextureAtlas_pack`,
+ * with `rects` where every texture is.
  */
-SDL_Texture *TexturesCache_get(SDL_Renderer *renderer, TextureType texture_type) {
-    if (!_textures_cache_initialized) {
-        TexturesCache_initialize();
+void TextureAtlas_upload(
+    SDL_Renderer *renderer, SDL_Surface *atlas, const SDL_Rect rects[TEXTURE_END_MARKER]
+) {
+    _atlas_texture = SDL_CreateTextureFromSurface(renderer, atlas);
+    if (_atlas_texture == NULL) {
+        sdl_fail();
     }
-    if (_textures_cache[texture_type] == NULL) {
-        _textures_cache[texture_type] = IMG_LoadTexture(
-            renderer,
-            TEXTURE_FILE_NAMES[texture_type]
-        );
-        if (_textures_cache[texture_type] == NULL) {
-            sdl_fail();
-        }
+    SDL_SetTextureBlendMode(_atlas_texture, SDL_BLENDMODE_BLEND);
+    _atlas_width = atlas->w;
+    _atlas_height = atlas->h;
+    memcpy(_atlas_rects, rects, sizeof(_atlas_rects));
+}
+
+void TextureAtlas_destroy() {
+    if (_atlas_texture != NULL) {
+        SDL_DestroyTexture(_atlas_texture);
+        _atlas_texture = NULL;
     }
-    return _textures_cache[texture_type];
 }
 
-/*** Sounds Cache ***/
+/**
+ * Where a texture is in the atlas, its width and height are the ones of the
+ * texture.
+ */
+SDL_Rect TextureAtlas_get_rect(TextureType texture_type) {
+    return _atlas_rects[texture_type];
+}
+
+/*** Sprite Batch ***/
+
+// number of quads there is room for at first, doubled whenever needed
+#define SPRITE_BATCH_INITIAL_CAPACITY 1024
+
+/**
+ * Everything on screen is a quad textured with a part of the atlas. Quads
+ * are collected here and sent to the renderer at once by `SpriteBatch_flush`,
+ * with a single `SDL_RenderGeometry` call, in the order they were added.
+ * Do not access these variables directly, use functions starting with 'SpriteBatch'.
+ */
+static SDL_Vertex *_batch_vertices = NULL; // 4 per quad
+static int *_batch_indices = NULL; // 6 per quad (2 triangles)
+static Uint32 _batch_count = 0; // quads
+static Uint32 _batch_capacity = 0;
+
+void SpriteBatch_grow() {
+    Uint32 capacity = MAX(_batch_capacity * 2, (Uint32)SPRITE_BATCH_INITIAL_CAPACITY);
+    SDL_Vertex *vertices = realloc(_batch_vertices, capacity * 4 * sizeof(SDL_Vertex));
+    int *indices = realloc(_batch_indices, capacity * 6 * sizeof(int));
+    if (vertices == NULL || indices == NULL) {
+        printf("ERROR: out of memory for %u sprites\n", capacity);
+        exit(1);
+    }
+    // the quads never change their layout
+    for (Uint32 i = _batch_capacity; i < capacity; i++) {
+        int first = i * 4;
+        int *quad = &indices[i * 6];
+        quad[0] = first;
+        quad[1] = first + 1;
+        quad[2] = first + 2;
+        quad[3] = first + 2;
+        quad[4] = first + 3;
+        quad[5] = first;
+    }
+    _batch_vertices = vertices;
+    _batch_indices = indices;
+    _batch_capacity = capacity;
+}
+
+void SpriteBatch_destroy() {
+    free(_batch_vertices);
+    free(_batch_indices);
+    _batch_vertices = NULL;
+    _batch_indices = NULL;
+    _batch_count = _batch_capacity = 0;
+}
+
+/**
+ * Add a quad showing `src` (in atlas pixels) at `x`, `y` with size `w`, `h`,
+ * its pixels multiplied by `color`.
+ */
+void SpriteBatch_add_quad(float x, float y, float w, float h, SDL_Rect src, SDL_Color color) {
+    if (_batch_count == _batch_capacity) {
+        SpriteBatch_grow();
+    }
+    float u0 = (float)src.x / _atlas_width, u1 = (float)(src.x + src.w) / _atlas_width;
+    float v0 = (float)src.y / _atlas_height, v1 = (float)(src.y + src.h) / _atlas_height;
+    SDL_Vertex *vertices = &_batch_vertices[_batch_count++ * 4];
+    vertices[0] = (SDL_Vertex){{x, y}, color, {u0, v0}};
+    vertices[1] = (SDL_Vertex){{x + w, y}, color, {u1, v0}};
+    vertices[2] = (SDL_Vertex){{x + w, y + h}, color, {u1, v1}};
+    vertices[3] = (SDL_Vertex){{x, y + h}, color, {u0, v1}};
+}
+
+/**
+ * Draw the part `src_rect` of a texture (all of it if NULL) into `dst_rect`.
+ */
+void SpriteBatch_draw(TextureType texture_type, const SDL_Rect *src_rect, SDL_Rect dst_rect) {
+    SDL_Rect src = TextureAtlas_get_rect(texture_type);
+    if (src_rect != NULL) {
+        src = (SDL_Rect){src.x + src_rect->x, src.y + src_rect->y, src_rect->w, src_rect->h};
+    }
+    SpriteBatch_add_quad(
+        dst_rect.x, dst_rect.y, dst_rect.w, dst_rect.h, src, (SDL_Color){255, 255, 255, 255}
+    );
+}
+
+void SpriteBatch_fill_frect(float x, float y, float w, float h, SDL_Color color) {
+    SDL_Rect white = TextureAtlas_get_rect(TEXTURE_WHITE);
+    // the middle of the white square, away from the transparent padding
+    SDL_Rect middle = {white.x + 1, white.y + 1, white.w - 2, white.h - 2};
+    SpriteBatch_add_quad(x, y, w, h, middle, color);
+}
+
+void SpriteBatch_fill_rect(SDL_Rect rect, SDL_Color color) {
+    SpriteBatch_fill_frect(rect.x, rect.y, rect.w, rect.h, color);
+}
+
+/* Outline of `rect`, one pixel wide */
+void SpriteBatch_draw_rect(SDL_Rect rect, SDL_Color color) {
+    SpriteBatch_fill_rect((SDL_Rect){rect.x, rect.y, rect.w, 1}, color);
+    SpriteBatch_fill_rect((SDL_Rect){rect.x, rect.y + rect.h - 1, rect.w, 1}, color);
+    SpriteBatch_fill_rect((SDL_Rect){rect.x, rect.y + 1, 1, rect.h - 2}, color);
+    SpriteBatch_fill_rect((SDL_Rect){rect.x + rect.w - 1, rect.y + 1, 1, rect.h - 2}, color);
+}
+
+/**
+ * Draw everything added since the last flush with one call.
+ */
+void SpriteBatch_flush(SDL_Renderer *renderer) {
+    if (_batch_count == 0) {
+        return;
+    }
+    SDL_RenderGeometry(
+        renderer,
+        _atlas_texture,
+        _batch_vertices,
+        _batch_count * 4,
+        _batch_indices,
+        _batch_count * 6
+    );
+    _batch_count = 0;
+}
+
+/*** Sounds ***/
 
 typedef enum {
     SOUND_CHUNK_EXPLOSION,
     SOUND_CHUNK_LASER,
     SOUND_CHUNK_LOST,
-    SOUND_CHUNK_END_MARKER // the number of available textures
+    SOUND_CHUNK_END_MARKER // the number of available sounds
 } SoundChunkType;
 
 static char *SOUND_CHUNKS_FILE_NAMES[SOUND_CHUNK_END_MARKER] = {
@@ -196,458 +447,1702 @@ static char *SOUND_CHUNKS_FILE_NAMES[SOUND_CHUNK_END_MARKER] = {
 };
 
 /**
- * Do not access these variables directly, use functions starting with 'TexturesCache'.
+ * Load a sound as PCM in the format it is mixed in (see AUDIO_FORMAT), so that
+ * it can be played as it is. The result must be freed with `SDL_free`.
  */
-static Mix_Chunk *_chunks_cache[SOUND_CHUNK_END_MARKER];
-static bool _chunks_cache_initialized = false;
+Uint8 *load_sound_pcm(SoundChunkType sound_chunk_type, Uint32 *size) {
+    SDL_AudioSpec spec;
+    Uint8 *wav;
+    Uint32 wav_size;
+    if (SDL_LoadWAV(SOUND_CHUNKS_FILE_NAMES[sound_chunk_type], &spec, &wav, &wav_size) == NULL) {
+        sdl_fail();
+    }
+    SDL_AudioCVT cvt;
+    if (SDL_BuildAudioCVT(
+        &cvt, spec.format, spec.channels, spec.freq, AUDIO_FORMAT, AUDIO_CHANNELS, AUDIO_FREQUENCY
+    ) < 0) {
+        sdl_fail();
+    }
+    cvt.len = wav_size;
+    cvt.buf = SDL_malloc(wav_size * cvt.len_mult);
+    if (cvt.buf == NULL) {
+        printf("ERROR: out of memory for %s\n", SOUND_CHUNKS_FILE_NAMES[sound_chunk_type]);
+        exit(1);
+    }
+    memcpy(cvt.buf, wav, wav_size);
+    SDL_FreeWAV(wav);
+    if (SDL_ConvertAudio(&cvt) != 0) {
+        sdl_fail();
+    }
+    *size = cvt.len_cvt;
+    return cvt.buf;
+}
+
+/*** Asset Bundle ***/
+
+#define ASSET_BUNDLE_FILE_NAME "assets.bundle"
+// change it whenever the layout of the bundle or the assets in it change
+#define ASSET_BUNDLE_VERSION 1
+
+/* Part of the bundle, `offset` bytes from its start */
+typedef struct {
+    Uint32 offset;
+    Uint32 size;
+} BundleBlob;
+
+/**
+ * All the assets in one file, decoded and ready to be used: the texture atlas
+ * as RGBA pixels and the sounds as PCM in the format they are mixed in. It is
+ * built from assets/ by `./spaceships --pack` and mapped into memory when the
+ * game starts, so that nothing is read from the disk or decoded afterwards.
+ * The header is followed by the blobs it points to. Numbers are stored in the
+ * byte order of the machine which packed the bundle.
+ */
+typedef struct {
+    char magic[4];
+    Uint32 version;
+    Uint32 textures_count;
+    Uint32 sounds_count;
+    Uint32 atlas_width, atlas_height;
+    SDL_Rect atlas_rects[TEXTURE_END_MARKER];
+    BundleBlob atlas; // rows of atlas_width * 4 bytes
+    Sint32 audio_frequency;
+    Uint16 audio_format;
+    Uint16 audio_channels;
+    BundleBlob sounds[SOUND_CHUNK_END_MARKER];
+} BundleHeader;
+
+static const char ASSET_BUNDLE_MAGIC[4] = {'S', 'S', 'A', 'B'};
 
 /**
- * Initialize the sound chunks cache. It is called automatically on the first call to
- * `TexturesCache_get`.
+ * The mapped bundle, sound chunks may point into it.
+ * Do not access these variables directly, use functions starting with 'AssetBundle'.
  */
-void SoundChunksCache_initialize() {
+static void *_bundle = NULL;
+static size_t _bundle_size = 0;
+static bool _bundle_has_sounds = false;
+
+/**
+ * Decode all the assets and write them to the bundle `file_name`.
+ */
+void AssetBundle_pack(const char *file_name) {
+    if (IMG_Init(IMG_INIT_PNG) == 0) {
+        sdl_fail();
+    }
+    BundleHeader header = {0};
+    memcpy(header.magic, ASSET_BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = ASSET_BUNDLE_VERSION;
+    header.textures_count = TEXTURE_END_MARKER;
+    header.sounds_count = SOUND_CHUNK_END_MARKER;
+    header.audio_frequency = AUDIO_FREQUENCY;
+    header.audio_format = AUDIO_FORMAT;
+    header.audio_channels = AUDIO_CHANNELS;
+
+    SDL_Surface *atlas = TextureAtlas_pack(header.atlas_rects);
+    header.atlas_width = atlas->w;
+    header.atlas_height = atlas->h;
+    Uint32 offset = sizeof(BundleHeader);
+    header.atlas = (BundleBlob){offset, atlas->w * atlas->h * 4};
+    offset += header.atlas.size;
+
+    Uint8 *sounds[SOUND_CHUNK_END_MARKER];
+    for (int i = 0; i < SOUND_CHUNK_END_MARKER; i++) {
+        sounds[i] = load_sound_pcm(i, &header.sounds[i].size);
+        header.sounds[i].offset = offset;
+        // every blob starts 4 bytes aligned
+        offset += (header.sounds[i].size + 3) & ~3u;
+    }
+
+    FILE *file = fopen(file_name, "wb");
+    if (file == NULL) {
+        printf("ERROR: can't write %s\n", file_name);
+        exit(1);
+    }
+    fwrite(&header, sizeof(header), 1, file);
+    for (int y = 0; y < atlas->h; y++) {
+        fwrite((Uint8 *)atlas->pixels + y * atlas->pitch, atlas->w * 4, 1, file);
+    }
     for (int i = 0; i < SOUND_CHUNK_END_MARKER; i++) {
-        _chunks_cache[i] = NULL;
+        static const Uint8 padding[3] = {0};
+        fwrite(sounds[i], header.sounds[i].size, 1, file);
+        fwrite(padding, -header.sounds[i].size & 3u, 1, file);
+        SDL_free(sounds[i]);
+    }
+    if (ferror(file) || fclose(file) != 0) {
+        printf("ERROR: can't write %s\n", file_name);
+        exit(1);
     }
-    _chunks_cache_initialized = true;
+    SDL_FreeSurface(atlas);
+    IMG_Quit();
+    printf(
+        "Packed %d textures and %d sounds into %s (%u bytes)\n",
+        TEXTURE_END_MARKER, SOUND_CHUNK_END_MARKER, file_name, offset
+    );
+}
+
+bool BundleBlob_fits(BundleBlob blob, size_t bundle_size) {
+    return blob.offset <= bundle_size && blob.size <= bundle_size - blob.offset;
 }
 
 /**
- * This function clears the cache. Make sure to call it before the program ends
- * so that all the sound chunks can be destroyed.
+ * Whether the atlas of the header can become a surface, its pixels are exactly
+ * the atlas blob and every texture lies within it. The size is computed in
+ * size_t, since a corrupted width and height overflow 32 bits.
  */
-void SoundChunksCache_destroy() {
-    if (!_chunks_cache_initialized) {
-        return;
+bool BundleHeader_atlas_is_valid(const BundleHeader *header) {
+    Uint32 width = header->atlas_width, height = header->atlas_height;
+    // SDL surfaces have int sizes and pitches
+    if (width == 0 || height == 0 || width > SDL_MAX_SINT32 / 4 || height > SDL_MAX_SINT32) {
+        return false;
+    }
+    size_t pitch = (size_t)width * 4;
+    if (pitch > SIZE_MAX / height || pitch * height != header->atlas.size) {
+        return false;
+    }
+    for (int i = 0; i < TEXTURE_END_MARKER; i++) {
+        SDL_Rect rect = header->atlas_rects[i];
+        if (rect.x < 0 || rect.y < 0 || rect.w < 0 || rect.h < 0
+            || (Uint32)rect.x > width || (Uint32)rect.w > width - rect.x
+            || (Uint32)rect.y > height || (Uint32)rect.h > height - rect.y) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Validate the header of a mapped bundle of `size` bytes.
+ */
+bool BundleHeader_is_valid(const BundleHeader *header, size_t size) {
+    if (size < sizeof(BundleHeader)
+        || memcmp(header->magic, ASSET_BUNDLE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != ASSET_BUNDLE_VERSION
+        || header->textures_count != TEXTURE_END_MARKER
+        || header->sounds_count != SOUND_CHUNK_END_MARKER
+        || !BundleHeader_atlas_is_valid(header)
+        || !BundleBlob_fits(header->atlas, size)) {
+        return false;
     }
     for (int i = 0; i < SOUND_CHUNK_END_MARKER; i++) {
-        if (_chunks_cache[i] != NULL) {
-            Mix_FreeChunk(_chunks_cache[i]);
-            _chunks_cache[i] = NULL;
+        if (!BundleBlob_fits(header->sounds[i], size)) {
+            return false;
         }
     }
-    _chunks_cache_initialized = false;
+    return true;
 }
 
 /**
- * Play a chunk by `SoundChunkType`. Sound chunks cache will be initialized if was not
- * already initialized.
+ * Map the bundle `file_name`. Returns false if there is no valid bundle, the
+ * assets are then loaded from their files. Call it once audio is open.
  */
-void SoundChunkCache_play(SoundChunkType sound_chunk_type) {
-    if (!_chunks_cache_initialized) {
-        SoundChunksCache_initialize();
+bool AssetBundle_open(const char *file_name) {
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        printf("Warning: no %s, loading the assets from their files\n", file_name);
+        return false;
     }
-    if (_chunks_cache[sound_chunk_type] == NULL) {
-        _chunks_cache[sound_chunk_type] = Mix_LoadWAV(
-            SOUND_CHUNKS_FILE_NAMES[sound_chunk_type]
-        );
-        if (_chunks_cache[sound_chunk_type] == NULL) {
-            sdl_fail();
+    struct stat st;
+    void *bundle = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(BundleHeader)) {
+        bundle = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (bundle == MAP_FAILED || !BundleHeader_is_valid(bundle, st.st_size)) {
+        printf("Warning: %s is invalid or outdated, loading the assets from their files\n", file_name);
+        if (bundle != MAP_FAILED) {
+            munmap(bundle, st.st_size);
         }
+        return false;
     }
-    Mix_MasterVolume(MIX_MAX_VOLUME / 4);  // by default sounds are rather loud
-    Mix_PlayChannel(-1, _chunks_cache[sound_chunk_type], 0);
+    _bundle = bundle;
+    _bundle_size = st.st_size;
+
+    // sounds can only be used if audio is open in the format they were packed in
+    const BundleHeader *header = bundle;
+    int frequency, channels;
+    Uint16 format;
+    _bundle_has_sounds = Mix_QuerySpec(&frequency, &format, &channels) != 0
+        && frequency == header->audio_frequency
+        && format == header->audio_format
+        && channels == header->audio_channels;
+    return true;
 }
 
-/*** Entities ***/
+/**
+ * The atlas in the bundle, as a surface of the mapped pixels, or NULL if no
+ * bundle is open. `rects` is set to where every texture is.
+ */
+SDL_Surface *AssetBundle_get_atlas(SDL_Rect rects[TEXTURE_END_MARKER]) {
+    if (_bundle == NULL) {
+        return NULL;
+    }
+    const BundleHeader *header = _bundle;
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormatFrom(
+        (Uint8 *)_bundle + header->atlas.offset,
+        header->atlas_width,
+        header->atlas_height,
+        32,
+        header->atlas_width * 4,
+        SDL_PIXELFORMAT_RGBA32
+    );
+    if (atlas == NULL) {
+        sdl_fail();
+    }
+    memcpy(rects, header->atlas_rects, sizeof(header->atlas_rects));
+    return atlas;
+}
+
+/**
+ * The PCM of a sound in the bundle, or NULL if no bundle is open or its sounds
+ * can't be played as they are. It stays valid until the bundle is closed.
+ */
+Uint8 *AssetBundle_get_sound(SoundChunkType sound_chunk_type, Uint32 *size) {
+    if (_bundle == NULL || !_bundle_has_sounds) {
+        return NULL;
+    }
+    const BundleHeader *header = _bundle;
+    BundleBlob sound = header->sounds[sound_chunk_type];
+    *size = sound.size;
+    return (Uint8 *)_bundle + sound.offset;
+}
+
+/**
+ * Unmap the bundle. Sound chunks may point into it, so free them first.
+ */
+void AssetBundle_close() {
+    if (_bundle != NULL) {
+        munmap(_bundle, _bundle_size);
+        _bundle = NULL;
+        _bundle_size = 0;
+    }
+}
+
+/*** Resources ***/
+
+/**
+ * Everything the game loads: the texture atlas and the sounds. Resources are
+ * decoded on a background thread, from the asset bundle when there is one,
+ * and uploaded on the main thread (textures to the GPU, sounds to the mixer).
+ */
+typedef enum {
+    RESOURCE_ATLAS,
+    RESOURCE_SOUND, // the first sound, the others follow in the order of SoundChunkType
+    RESOURCE_END_MARKER = RESOURCE_SOUND + SOUND_CHUNK_END_MARKER // the number of resources
+} ResourceId;
+
+/* A set of resources, one bit per `ResourceId` */
+typedef Uint32 ResourceGroup;
+#define RESOURCE_BIT(id) (1u << (id))
+#define RESOURCE_SOUND_BIT(sound_chunk_type) RESOURCE_BIT(RESOURCE_SOUND + (sound_chunk_type))
+
+// everything needed while playing, loaded before the first frame
+#define RESOURCE_GROUP_GAMEPLAY ( \
+    RESOURCE_BIT(RESOURCE_ATLAS) \
+    | RESOURCE_SOUND_BIT(SOUND_CHUNK_EXPLOSION) \
+    | RESOURCE_SOUND_BIT(SOUND_CHUNK_LASER) \
+    | RESOURCE_SOUND_BIT(SOUND_CHUNK_LOST) \
+)
+#define RESOURCE_GROUP_GAME_OVER RESOURCE_BIT(RESOURCE_ATLAS)
+
+// bytes of resources kept loaded, unused resources are unloaded past it
+#define RESOURCES_MEMORY_BUDGET (16 * 1024 * 1024)
+
+typedef enum {
+    RESOURCE_UNLOADED,
+    RESOURCE_QUEUED, // waiting for the background thread
+    RESOURCE_DECODED, // waiting to be uploaded by the main thread
+    RESOURCE_READY,
+} ResourceState;
 
 typedef struct {
-    double rotation; // rotation in degrees
-    float dx, dy;
-    SDL_Rect rect;
-    SDL_Texture *texture;
-} Entity;
+    ResourceState state;
+    Uint32 refs; // acquired groups it belongs to, unloaded only at 0
+    Uint64 last_used; // frame it was last used in
+    Uint64 load_time; // decoding and uploading, in performance counter units
+    Uint32 bytes; // in memory once ready
+    // set by the background thread for the atlas
+    SDL_Surface *surface;
+    SDL_Rect rects[TEXTURE_END_MARKER];
+    // set by the background thread for a sound
+    Uint8 *pcm;
+    Uint32 pcm_size;
+    bool pcm_owned; // false when it points into the asset bundle
+    Mix_Chunk *chunk;
+} Resource;
 
 /**
- * Initialize `Entity` using an existing struct. Useful when reusing structs.
+ * `_resources_mutex` guards the state of the resources and the queue, the
+ * other fields of a resource are only touched by the thread its state hands
+ * it to. `_resources_cond` is signaled whenever either changes.
+ * Do not access these variables directly, use functions starting with 'Resources'.
  */
-void Entity_new_fill(
-    Entity *entity, double rotation, float dx, float dy, SDL_Rect rect, SDL_Texture *texture
-) {
-    entity->rotation = rotation;
-    entity->dx = dx;
-    entity->dy = dy;
-    entity->rect = rect;
-    entity->texture = texture;
+static Resource _resources[RESOURCE_END_MARKER];
+static ResourceId _resources_queue[RESOURCE_END_MARKER]; // every resource is queued at most once
+static Uint32 _resources_queue_start = 0, _resources_queue_count = 0;
+static bool _resources_quit = false;
+static SDL_mutex *_resources_mutex = NULL;
+static SDL_cond *_resources_cond = NULL;
+static SDL_Thread *_resources_thread = NULL;
+static SDL_Renderer *_resources_renderer = NULL;
+static Uint64 _resources_frame = 0;
+
+char *Resources_name(ResourceId id) {
+    return id == RESOURCE_ATLAS ? "atlas" : SOUND_CHUNKS_FILE_NAMES[id - RESOURCE_SOUND];
+}
 
+/* Runs on the background thread, with `_resources_mutex` unlocked */
+void Resources_decode(ResourceId id, Resource *resource) {
+    if (id == RESOURCE_ATLAS) {
+        resource->surface = AssetBundle_get_atlas(resource->rects);
+        if (resource->surface == NULL) {
+            resource->surface = TextureAtlas_pack(resource->rects);
+        }
+        return;
+    }
+    resource->pcm = AssetBundle_get_sound(id - RESOURCE_SOUND, &resource->pcm_size);
+    resource->pcm_owned = resource->pcm == NULL;
+    if (resource->pcm == NULL) {
+        resource->pcm = load_sound_pcm(id - RESOURCE_SOUND, &resource->pcm_size);
+    }
 }
 
-Entity *Entity_new(double rotation, float dx, float dy, SDL_Rect rect, SDL_Texture *texture) {
-    Entity *entity = malloc(sizeof(Entity));
-    Entity_new_fill(entity, rotation, dx, dy, rect, texture);
-    return entity;
+int Resources_run_thread(void *data) {
+    (void)data;
+    SDL_LockMutex(_resources_mutex);
+    while (1) {
+        while (_resources_queue_count == 0 && !_resources_quit) {
+            SDL_CondWait(_resources_cond, _resources_mutex);
+        }
+        if (_resources_quit) {
+            break;
+        }
+        ResourceId id = _resources_queue[_resources_queue_start];
+        _resources_queue_start = (_resources_queue_start + 1) % RESOURCE_END_MARKER;
+        _resources_queue_count--;
+        SDL_UnlockMutex(_resources_mutex);
+
+        Resource *resource = &_resources[id];
+        Uint64 start = SDL_GetPerformanceCounter();
+        Resources_decode(id, resource);
+        resource->load_time = SDL_GetPerformanceCounter() - start;
+
+        SDL_LockMutex(_resources_mutex);
+        resource->state = RESOURCE_DECODED;
+        SDL_CondBroadcast(_resources_cond);
+    }
+    SDL_UnlockMutex(_resources_mutex);
+    return 0;
+}
+
+/**
+ * Start the background thread, once the renderer is created and audio is
+ * open. Nothing is loaded until it is asked for.
+ */
+void Resources_initialize(SDL_Renderer *renderer) {
+    AssetBundle_open(ASSET_BUNDLE_FILE_NAME);
+    memset(_resources, 0, sizeof(_resources));
+    _resources_queue_start = _resources_queue_count = 0;
+    _resources_quit = false;
+    _resources_renderer = renderer;
+    _resources_mutex = SDL_CreateMutex();
+    _resources_cond = SDL_CreateCond();
+    if (_resources_mutex == NULL || _resources_cond == NULL) {
+        sdl_fail();
+    }
+    _resources_thread = SDL_CreateThread(Resources_run_thread, "resources", NULL);
+    if (_resources_thread == NULL) {
+        sdl_fail();
+    }
 }
 
-void Entity_destroy(Entity *entity) {
-    free(entity);
+/* Queue every unloaded resource of `group`, with `_resources_mutex` locked */
+void Resources_queue(ResourceGroup group) {
+    for (int i = 0; i < RESOURCE_END_MARKER; i++) {
+        if ((group & RESOURCE_BIT(i)) && _resources[i].state == RESOURCE_UNLOADED) {
+            Uint32 end = (_resources_queue_start + _resources_queue_count) % RESOURCE_END_MARKER;
+            _resources_queue[end] = i;
+            _resources_queue_count++;
+            _resources[i].state = RESOURCE_QUEUED;
+        }
+    }
+    SDL_CondBroadcast(_resources_cond);
 }
 
-void Entity_move(Entity *entity) {
-    entity->rect.x += entity->dx;
-    entity->rect.y += entity->dy;
+/* Runs on the main thread, once the resource is decoded */
+void Resources_upload(ResourceId id) {
+    Resource *resource = &_resources[id];
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (id == RESOURCE_ATLAS) {
+        TextureAtlas_upload(_resources_renderer, resource->surface, resource->rects);
+        resource->bytes = resource->surface->w * resource->surface->h * 4;
+        SDL_FreeSurface(resource->surface);
+        resource->surface = NULL;
+    } else {
+        resource->chunk = Mix_QuickLoad_RAW(resource->pcm, resource->pcm_size);
+        if (resource->chunk == NULL) {
+            sdl_fail();
+        }
+        resource->bytes = resource->pcm_size;
+    }
+    resource->load_time += SDL_GetPerformanceCounter() - start;
+    resource->last_used = _resources_frame;
+    SDL_LockMutex(_resources_mutex);
+    resource->state = RESOURCE_READY;
+    SDL_UnlockMutex(_resources_mutex);
 }
 
-void Entity_render(Entity *entity, SDL_Renderer *renderer) {
-    SDL_RenderCopyEx(
-        renderer,
-        entity->texture,
-        NULL,
-        &entity->rect,
-        entity->rotation,
-        NULL,
-        SDL_FLIP_NONE
+void Resources_unload(ResourceId id) {
+    Resource *resource = &_resources[id];
+    if (id == RESOURCE_ATLAS) {
+        SDL_FreeSurface(resource->surface);
+        resource->surface = NULL;
+        TextureAtlas_destroy();
+    } else {
+        if (resource->chunk != NULL) {
+            Mix_FreeChunk(resource->chunk);
+            resource->chunk = NULL;
+        }
+        if (resource->pcm_owned) {
+            SDL_free(resource->pcm);
+        }
+        resource->pcm = NULL;
+    }
+    resource->bytes = 0;
+    SDL_LockMutex(_resources_mutex);
+    resource->state = RESOURCE_UNLOADED;
+    SDL_UnlockMutex(_resources_mutex);
+}
+
+Uint64 Resources_resident_bytes() {
+    Uint64 bytes = 0;
+    for (int i = 0; i < RESOURCE_END_MARKER; i++) {
+        bytes += _resources[i].bytes;
+    }
+    return bytes;
+}
+
+/**
+ * Upload the resources decoded since the last call and unload the least
+ * recently used of those not acquired while over RESOURCES_MEMORY_BUDGET.
+ * Call it once a frame.
+ */
+void Resources_update() {
+    _resources_frame++;
+    ResourceGroup decoded = 0;
+    SDL_LockMutex(_resources_mutex);
+    for (int i = 0; i < RESOURCE_END_MARKER; i++) {
+        if (_resources[i].state == RESOURCE_DECODED) {
+            decoded |= RESOURCE_BIT(i);
+        }
+    }
+    SDL_UnlockMutex(_resources_mutex);
+    for (int i = 0; i < RESOURCE_END_MARKER; i++) {
+        if (decoded & RESOURCE_BIT(i)) {
+            Resources_upload(i);
+        }
+    }
+
+    Uint64 bytes = Resources_resident_bytes();
+    while (bytes > RESOURCES_MEMORY_BUDGET) {
+        int oldest = -1;
+        for (int i = 0; i < RESOURCE_END_MARKER; i++) {
+            Resource *resource = &_resources[i];
+            if (resource->state == RESOURCE_READY && resource->refs == 0
+                && (oldest < 0 || resource->last_used < _resources[oldest].last_used)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            break; // everything left is in use
+        }
+        bytes -= _resources[oldest].bytes;
+        Resources_unload(oldest);
+    }
+}
+
+/**
+ * Keep the resources of `group` loaded until released, they start loading in
+ * the background if they are not.
+ */
+void Resources_acquire(ResourceGroup group) {
+    SDL_LockMutex(_resources_mutex);
+    for (int i = 0; i < RESOURCE_END_MARKER; i++) {
+        if (group & RESOURCE_BIT(i)) {
+            _resources[i].refs++;
+        }
+    }
+    Resources_queue(group);
+    SDL_UnlockMutex(_resources_mutex);
+}
+
+/**
+ * Allow the resources of `group` to be unloaded, when over the memory budget
+ * and no other acquired group needs them.
+ */
+void Resources_release(ResourceGroup group) {
+    for (int i = 0; i < RESOURCE_END_MARKER; i++) {
+        if ((group & RESOURCE_BIT(i)) && _resources[i].refs > 0) {
+            _resources[i].refs--;
+        }
+    }
+}
+
+/**
+ * Block until every resource of `group` is ready, loading those which are not.
+ */
+void Resources_wait(ResourceGroup group) {
+    SDL_LockMutex(_resources_mutex);
+    Resources_queue(group);
+    while (1) {
+        bool decoding = false;
+        for (int i = 0; i < RESOURCE_END_MARKER; i++) {
+            ResourceState state = _resources[i].state;
+            decoding |= (group & RESOURCE_BIT(i)) && state != RESOURCE_DECODED && state != RESOURCE_READY;
+        }
+        if (!decoding) {
+            break;
+        }
+        SDL_CondWait(_resources_cond, _resources_mutex);
+    }
+    SDL_UnlockMutex(_resources_mutex);
+    Resources_update();
+}
+
+/**
+ * The sound chunk of a sound, NULL if it is not loaded yet. In that case it
+ * starts loading in the background.
+ */
+Mix_Chunk *Resources_get_sound(SoundChunkType sound_chunk_type) {
+    Resource *resource = &_resources[RESOURCE_SOUND + sound_chunk_type];
+    SDL_LockMutex(_resources_mutex);
+    ResourceState state = resource->state;
+    if (state == RESOURCE_UNLOADED) {
+        Resources_queue(RESOURCE_SOUND_BIT(sound_chunk_type));
+    }
+    SDL_UnlockMutex(_resources_mutex);
+    if (state != RESOURCE_READY) {
+        return NULL;
+    }
+    resource->last_used = _resources_frame;
+    return resource->chunk;
+}
+
+/**
+ * Print the state, size and load time of every resource.
+ */
+void Resources_print_stats() {
+    double ms = 1000. / SDL_GetPerformanceFrequency();
+    static char *STATE_NAMES[] = {"unloaded", "queued", "decoded", "ready"};
+    printf("resources from %s\n", _bundle != NULL ? ASSET_BUNDLE_FILE_NAME : "their files");
+    SDL_LockMutex(_resources_mutex);
+    for (int i = 0; i < RESOURCE_END_MARKER; i++) {
+        Resource *resource = &_resources[i];
+        printf(
+            "  %-30s %-8s %8.1f KB %8.3f ms\n",
+            Resources_name(i), STATE_NAMES[resource->state], resource->bytes / 1024.,
+            resource->load_time * ms
+        );
+    }
+    SDL_UnlockMutex(_resources_mutex);
+    printf(
+        "  %-30s %-8s %8.1f KB of %.1f KB\n",
+        "resident", "", Resources_resident_bytes() / 1024., RESOURCES_MEMORY_BUDGET / 1024.
     );
-    if(DEBUG) {
-        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 128);
-        SDL_RenderDrawRect(renderer, &entity->rect);
+}
+
+/**
+ * Stop the background thread and unload everything.
+ */
+void Resources_destroy() {
+    SDL_LockMutex(_resources_mutex);
+    _resources_quit = true;
+    SDL_CondBroadcast(_resources_cond);
+    SDL_UnlockMutex(_resources_mutex);
+    SDL_WaitThread(_resources_thread, NULL);
+    _resources_thread = NULL;
+    for (int i = 0; i < RESOURCE_END_MARKER; i++) {
+        Resources_unload(i);
     }
+    AssetBundle_close();
+    SDL_DestroyCond(_resources_cond);
+    SDL_DestroyMutex(_resources_mutex);
+    _resources_cond = NULL;
+    _resources_mutex = NULL;
 }
 
-typedef struct Spaceship {
-    Entity *entity;
-    Uint32 reload;  // frames left for reloading, can shoot whenever 0
-    bool fire;  // true if player/bot tries to shoot, false otherwise
-    Uint32 max_health;
-    Uint32 health;
-    struct Spaceship *next; // the first spaceship is always the player
-} Spaceship;
+/*** Voices ***/
 
-/*** Bullet ***/
+// mixer channels, the most sounds playing at once
+#define VOICES_COUNT 12
 
-typedef Entity Bullet;
+typedef struct {
+    Uint32 max_voices; // copies of the sound playing at once
+    Uint32 priority; // a sound can stop one of lower or equal priority to play
+} SoundSettings;
+
+static SoundSettings SOUND_SETTINGS[SOUND_CHUNK_END_MARKER] = {
+    {6, 2}, // explosion
+    {4, 1}, // laser
+    {1, 3}, // lost
+};
 
-void Bullet_new_fill(
-    Bullet *bullet, double rotation, float dx, float dy, SDL_Rect rect, SDL_Texture *texture
-) {
-    Entity_new_fill(bullet, rotation, dx, dy, rect, texture);
+typedef struct {
+    bool playing;
+    SoundChunkType sound;
+    Uint64 order; // sounds played before it, the lowest is the oldest
+} Voice;
+
+typedef struct {
+    Uint64 triggered; // calls to `play_sound`
+    Uint64 merged; // triggers of a sound already triggered in the same frame
+    Uint64 played;
+    Uint64 stolen; // voices stopped to play another sound
+    Uint64 dropped; // triggers which found no voice to play in
+    Uint32 playing; // voices playing after the last update
+    Uint32 peak; // most voices playing at once
+} VoicesStats;
+
+/**
+ * A voice is a mixer channel. Sounds are triggered during a frame and played
+ * once per frame by `Voices_update`, each at most once, so that many ships
+ * firing in the same frame make one sound and not a stack of identical ones.
+ * Do not access these variables directly, use functions starting with 'Voices'.
+ */
+static Voice _voices[VOICES_COUNT];
+static Uint32 _voices_triggers[SOUND_CHUNK_END_MARKER]; // since the last update
+static Uint64 _voices_order = 0;
+static VoicesStats _voices_stats;
+
+/**
+ * Allocate the voices, once audio is open.
+ */
+void Voices_initialize() {
+    Mix_AllocateChannels(VOICES_COUNT);
+    Mix_MasterVolume(MIX_MAX_VOLUME / 4);  // by default sounds are rather loud
+    memset(_voices, 0, sizeof(_voices));
+    memset(_voices_triggers, 0, sizeof(_voices_triggers));
+    memset(&_voices_stats, 0, sizeof(_voices_stats));
 }
 
-void Bullet_new_fill_regular_bullet(
-    Bullet *bullet,
-    SDL_Renderer *renderer,
-    Uint32 x,
-    Uint32 y,
-    bool reverse
-) {
-    SDL_Rect rect = {x, y, BULLET_WIDTH, BULLET_HEIGHT};
-    float bullet_speed = -BULLET_SPEED;
-    if (reverse) {
-        bullet_speed *= -1;
+/**
+ * Play a sound with the next call to `Voices_update`.
+ */
+void play_sound(SoundChunkType sound_chunk_type) {
+    _voices_stats.triggered++;
+    if (_voices_triggers[sound_chunk_type]++ > 0) {
+        _voices_stats.merged++;
     }
-    Bullet_new_fill(
-        bullet, 0, 0, bullet_speed, rect, TexturesCache_get(renderer, TEXTURE_LASER)
+}
+
+/**
+ * Find the voice to play a sound in: the oldest copy of the sound when it
+ * plays as many times as it can, otherwise a free voice, otherwise the voice
+ * to steal, with the lowest priority and then the oldest. Returns -1 if every
+ * voice plays something more important.
+ */
+int Voices_find(SoundChunkType sound_chunk_type) {
+    SoundSettings settings = SOUND_SETTINGS[sound_chunk_type];
+    int oldest_copy = -1, free_voice = -1, victim = -1;
+    Uint32 copies = 0;
+    for (int i = 0; i < VOICES_COUNT; i++) {
+        Voice *voice = &_voices[i];
+        if (!voice->playing) {
+            free_voice = free_voice < 0 ? i : free_voice;
+            continue;
+        }
+        if (voice->sound == sound_chunk_type) {
+            copies++;
+            if (oldest_copy < 0 || voice->order < _voices[oldest_copy].order) {
+                oldest_copy = i;
+            }
+        }
+        Uint32 priority = SOUND_SETTINGS[voice->sound].priority;
+        if (priority > settings.priority) {
+            continue;
+        }
+        if (victim < 0) {
+            victim = i;
+            continue;
+        }
+        Uint32 victim_priority = SOUND_SETTINGS[_voices[victim].sound].priority;
+        if (priority < victim_priority
+            || (priority == victim_priority && voice->order < _voices[victim].order)) {
+            victim = i;
+        }
+    }
+    if (copies >= settings.max_voices) {
+        return oldest_copy;
+    }
+    return free_voice >= 0 ? free_voice : victim;
+}
+
+void Voices_play(SoundChunkType sound_chunk_type) {
+    Mix_Chunk *chunk = Resources_get_sound(sound_chunk_type);
+    if (chunk == NULL) {
+        return; // still loading
+    }
+    int channel = Voices_find(sound_chunk_type);
+    if (channel < 0) {
+        _voices_stats.dropped++;
+        return;
+    }
+    if (_voices[channel].playing) {
+        _voices_stats.stolen++;
+    }
+    // a channel which is playing is stopped first
+    if (Mix_PlayChannel(channel, chunk, 0) < 0) {
+        _voices_stats.dropped++;
+        return;
+    }
+    _voices[channel] = (Voice){true, sound_chunk_type, _voices_order++};
+    _voices_stats.played++;
+}
+
+/**
+ * Play the sounds triggered since the last call, the most important first.
+ * Call it once a frame.
+ */
+void Voices_update() {
+    for (int i = 0; i < VOICES_COUNT; i++) {
+        _voices[i].playing = _voices[i].playing && Mix_Playing(i);
+    }
+    while (1) {
+        int next = -1;
+        for (int i = 0; i < SOUND_CHUNK_END_MARKER; i++) {
+            if (_voices_triggers[i] > 0
+                && (next < 0 || SOUND_SETTINGS[i].priority > SOUND_SETTINGS[next].priority)) {
+                next = i;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        _voices_triggers[next] = 0;
+        Voices_play(next);
+    }
+    Uint32 playing = 0;
+    for (int i = 0; i < VOICES_COUNT; i++) {
+        playing += _voices[i].playing;
+    }
+    _voices_stats.playing = playing;
+    _voices_stats.peak = MAX(_voices_stats.peak, playing);
+}
+
+VoicesStats Voices_get_stats() {
+    return _voices_stats;
+}
+
+void Voices_print_stats() {
+    VoicesStats stats = _voices_stats;
+    printf(
+        "voices: %lu triggered, %lu merged, %lu played, %lu stolen, %lu dropped, peak %u of %d\n",
+        (unsigned long)stats.triggered, (unsigned long)stats.merged, (unsigned long)stats.played,
+        (unsigned long)stats.stolen, (unsigned long)stats.dropped, stats.peak, VOICES_COUNT
     );
-    SoundChunkCache_play(SOUND_CHUNK_LASER);
 }
 
-void Bullet_destroy(Bullet *bullet) {
-    free(bullet);
+/*** Pools ***/
+
+#define MAX_POOL_SIZE 64
+
+/**
+ * Reference to an element of a pool. It can be kept for as long as needed:
+ * once the element is removed, `Pool_lookup` rejects the handle even if the
+ * slot has been reused since.
+ */
+typedef struct {
+    Uint32 slot;
+    Uint32 generation;
+} Handle;
+
+/**
+ * Keeps track of up to `capacity` elements stored at indices 0 to `count - 1`
+ * of the arrays of its owner, so that systems iterate over dense arrays.
+ * Elements are reached from outside through handles, since removing an
+ * element moves the last one into its place.
+ */
+typedef struct {
+    Uint32 capacity;
+    Uint32 count;
+    Uint32 generation[MAX_POOL_SIZE]; // of every slot, bumped on removal
+    Uint32 index[MAX_POOL_SIZE]; // of the element of every slot in use
+    Uint32 slot[MAX_POOL_SIZE]; // of every element
+    Uint32 free_slots[MAX_POOL_SIZE];
+    Uint32 free_count;
+} Pool;
+
+void Pool_init(Pool *pool, Uint32 capacity) {
+    if (capacity > MAX_POOL_SIZE) {
+        printf("ERROR: pool of %u elements, at most %u are supported\n", capacity, MAX_POOL_SIZE);
+        exit(1);
+    }
+    pool->capacity = capacity;
+    pool->count = 0;
+    pool->free_count = pool->capacity;
+    for (Uint32 i = 0; i < pool->capacity; i++) {
+        pool->generation[i] = 0;
+        // lowest slots first
+        pool->free_slots[i] = pool->capacity - 1 - i;
+    }
+}
+
+/**
+ * Reserve the element at `*index`. Returns false when the pool is full.
+ */
+bool Pool_add(Pool *pool, Handle *handle, Uint32 *index) {
+    if (pool->free_count == 0) {
+        return false;
+    }
+    Uint32 slot = pool->free_slots[--pool->free_count];
+    *index = pool->count++;
+    pool->index[slot] = *index;
+    pool->slot[*index] = slot;
+    if (handle != NULL) {
+        *handle = (Handle){slot, pool->generation[slot]};
+    }
+    return true;
+}
+
+bool Pool_lookup(Pool *pool, Handle handle, Uint32 *index) {
+    if (handle.slot >= pool->capacity || pool->generation[handle.slot] != handle.generation) {
+        return false;
+    }
+    *index = pool->index[handle.slot];
+    return *index < pool->count && pool->slot[*index] == handle.slot;
+}
+
+/**
+ * Free the element at `index`. The last element takes its place: the owner
+ * must move its data from index `pool->count` (after the call) to `index`.
+ */
+void Pool_remove(Pool *pool, Uint32 index) {
+    Uint32 slot = pool->slot[index];
+    pool->generation[slot]++;
+    pool->free_slots[pool->free_count++] = slot;
+    Uint32 last = --pool->count;
+    if (index != last) {
+        pool->slot[index] = pool->slot[last];
+        pool->index[pool->slot[index]] = index;
+    }
+}
+
+/*** Components ***/
+
+typedef struct {
+    float x, y; // exact position of the top left corner
+    float prev_x, prev_y; // position before the last simulation step
+    int w, h;
+} Transform;
+
+typedef struct {
+    float dx, dy; // pixels/second
+} Velocity;
+
+typedef struct {
+    Uint32 health;
+    Uint32 max_health;
+} Health;
+
+typedef struct {
+    float reload; // seconds left for reloading, can shoot whenever 0
+    bool fire; // true if player/bot tries to shoot, false otherwise
+} Weapon;
+
+typedef struct {
+    TextureType texture;
+} Sprite;
+
+void Transform_init(Transform *transform, SDL_Rect rect) {
+    transform->x = transform->prev_x = rect.x;
+    transform->y = transform->prev_y = rect.y;
+    transform->w = rect.w;
+    transform->h = rect.h;
+}
+
+/* The rectangle used for collisions */
+SDL_Rect Transform_rect(const Transform *transform) {
+    return (SDL_Rect){roundf(transform->x), roundf(transform->y), transform->w, transform->h};
+}
+
+/**
+ * Where the entity is shown, `alpha` (0 to 1) of the way from the previous
+ * simulation step to the last one.
+ */
+SDL_Rect Transform_interpolated_rect(const Transform *transform, float alpha) {
+    return (SDL_Rect){
+        roundf(transform->prev_x + (transform->x - transform->prev_x) * alpha),
+        roundf(transform->prev_y + (transform->y - transform->prev_y) * alpha),
+        transform->w,
+        transform->h
+    };
+}
+
+/* Call this routine every simulation step */
+void Transform_move(Transform *transform, const Velocity *velocity, float dt) {
+    transform->prev_x = transform->x;
+    transform->prev_y = transform->y;
+    transform->x += velocity->dx * dt;
+    transform->y += velocity->dy * dt;
+}
+
+/* Spaceships facing down use the turned texture */
+bool Sprite_facing_down(const Sprite *sprite) {
+    return sprite->texture == TEXTURE_SPACESHIP_TURNED;
+}
+
+void Sprite_render(const Sprite *sprite, const Transform *transform, float alpha) {
+    SDL_Rect rect = Transform_interpolated_rect(transform, alpha);
+    SpriteBatch_draw(sprite->texture, NULL, rect);
+    if(DEBUG) {
+        SpriteBatch_draw_rect(rect, (SDL_Color){255, 0, 0, 128});
+    }
 }
 
 /*** Bullets Manager ***/
 
+// number of bullets there is room for at first, doubled whenever needed
+#define BULLETS_INITIAL_CAPACITY 64
+
+/**
+ * All the bullets in flight, one array per coordinate. Bullets are at indices
+ * 0 to `count - 1` and a removed bullet is replaced by the last one. The
+ * arrays grow when they are full, so no bullet is ever dropped. All bullets
+ * have the same size and texture.
+ */
 typedef struct {
-    Bullet objs[MAX_BULLETS_NUM];
-    bool used[MAX_BULLETS_NUM];
-    size_t head;
-    size_t tail;
+    Uint32 count;
+    Uint32 capacity;
+    float *x, *y; // top left corner
+    float *dx, *dy; // pixels/second
 } BulletsManager;
 
 BulletsManager *BulletsManager_new() {
     BulletsManager *bullets_manager = malloc(sizeof(BulletsManager));
-    memset(bullets_manager->objs, 0, sizeof(Bullet*) * MAX_BULLETS_NUM);
-    memset(bullets_manager->used, 0, sizeof(bool) * MAX_BULLETS_NUM);
-    bullets_manager->head = 0;
-    bullets_manager->tail = 0;
+    bullets_manager->count = 0;
+    bullets_manager->capacity = 0;
+    bullets_manager->x = bullets_manager->y = NULL;
+    bullets_manager->dx = bullets_manager->dy = NULL;
     return bullets_manager;
 }
 
+void BulletsManager_clear(BulletsManager *bullets_manager) {
+    bullets_manager->count = 0;
+}
+
 void BulletsManager_destroy(BulletsManager *bullets_manager) {
+    free(bullets_manager->x);
+    free(bullets_manager->y);
+    free(bullets_manager->dx);
+    free(bullets_manager->dy);
     free(bullets_manager);
 }
 
-void BulletsManager_add_bullet(
-    BulletsManager *bullets, SDL_Renderer *renderer, Spaceship *spaceship, bool reverse
-) {
-    SDL_Rect *spaceship_rect = &spaceship->entity->rect;
-    Bullet_new_fill_regular_bullet(
-        &bullets->objs[bullets->tail],
-        renderer,
-        spaceship_rect->x + (spaceship_rect->w / 2.) - (BULLET_WIDTH / 2.),
-        reverse ? spaceship_rect->y + spaceship_rect->h : spaceship_rect->y - BULLET_HEIGHT,
-        reverse
+void BulletsManager_grow(BulletsManager *bullets_manager) {
+    Uint32 capacity = MAX(bullets_manager->capacity * 2, (Uint32)BULLETS_INITIAL_CAPACITY);
+    float **arrays[] = {
+        &bullets_manager->x, &bullets_manager->y, &bullets_manager->dx, &bullets_manager->dy
+    };
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+        float *array = realloc(*arrays[i], capacity * sizeof(float));
+        if (array == NULL) {
+            printf("ERROR: out of memory for %u bullets\n", capacity);
+            exit(1);
+        }
+        *arrays[i] = array;
+    }
+    bullets_manager->capacity = capacity;
+}
+
+void BulletsManager_add(BulletsManager *bullets_manager, float x, float y, float dx, float dy) {
+    if (bullets_manager->count == bullets_manager->capacity) {
+        BulletsManager_grow(bullets_manager);
+    }
+    Uint32 i = bullets_manager->count++;
+    bullets_manager->x[i] = x;
+    bullets_manager->y[i] = y;
+    bullets_manager->dx[i] = dx;
+    bullets_manager->dy[i] = dy;
+}
+
+/* The last bullet takes the place of the removed one */
+void BulletsManager_remove(BulletsManager *bullets_manager, Uint32 i) {
+    Uint32 last = --bullets_manager->count;
+    bullets_manager->x[i] = bullets_manager->x[last];
+    bullets_manager->y[i] = bullets_manager->y[last];
+    bullets_manager->dx[i] = bullets_manager->dx[last];
+    bullets_manager->dy[i] = bullets_manager->dy[last];
+}
+
+/**
+ * Fire a bullet from the middle of the front of `rect`, up or down
+ * (`reverse`).
+ */
+void BulletsManager_add_bullet(BulletsManager *bullets, SDL_Rect rect, bool reverse) {
+    BulletsManager_add(
+        bullets,
+        rect.x + (rect.w / 2.) - (BULLET_WIDTH / 2.),
+        reverse ? rect.y + rect.h : rect.y - BULLET_HEIGHT,
+        0,
+        reverse ? BULLET_SPEED : -BULLET_SPEED
     );
-    bullets->used[bullets->tail] = true;
-    bullets->tail = (bullets->tail + 1) % MAX_BULLETS_NUM;
-    if (bullets->tail == bullets->head) {
-        bullets->head = (bullets->head + 1) % MAX_BULLETS_NUM;
-    }
-}
-
-void BulletsManager_move_bullets(BulletsManager *bullets_manager) {
-    for (
-        size_t i = bullets_manager->head;
-        i != bullets_manager->tail && !bullets_manager->used[i];
-        i = (i + 1) % MAX_BULLETS_NUM
-    ) {
-        bullets_manager->head = (bullets_manager->head + 1) % MAX_BULLETS_NUM;
-    }
-
-    for (
-        size_t i = bullets_manager->head;
-        i != bullets_manager->tail;
-        i = (i + 1) % MAX_BULLETS_NUM
-    ) {
-        Bullet *b = &bullets_manager->objs[i];
-        if (bullets_manager->used[i]) {
-            Entity_move(b);
-            if (b->rect.y + BULLET_HEIGHT < 0) {
-                bullets_manager->used[i] = false;
-            }
+    play_sound(SOUND_CHUNK_LASER);
+}
+
+/* The rectangle used for collisions */
+SDL_Rect BulletsManager_rect(BulletsManager *bullets_manager, Uint32 i) {
+    return (SDL_Rect){
+        roundf(bullets_manager->x[i]), roundf(bullets_manager->y[i]), BULLET_WIDTH, BULLET_HEIGHT
+    };
+}
+
+/**
+ * Four floats handled by one SSE instruction, or whatever the target has. GCC
+ * only vectorizes loops of unknown length on its own from -O3, so the loops
+ * over every bullet or particle use this type and finish with a scalar tail.
+ * Arrays are loaded and stored through memcpy since they are not aligned.
+ */
+typedef float Float4 __attribute__((vector_size(4 * sizeof(float))));
+
+/* Call this routine every simulation step */
+void BulletsManager_move_bullets(BulletsManager *bullets_manager, float dt) {
+    Uint32 count = bullets_manager->count;
+    {
+        float *restrict x = bullets_manager->x, *restrict y = bullets_manager->y;
+        float *restrict dx = bullets_manager->dx, *restrict dy = bullets_manager->dy;
+        Float4 dt4 = {dt, dt, dt, dt};
+        Uint32 i = 0;
+        for (; i + 4 <= count; i += 4) {
+            Float4 x4, y4, dx4, dy4;
+            memcpy(&x4, x + i, sizeof(Float4));
+            memcpy(&y4, y + i, sizeof(Float4));
+            memcpy(&dx4, dx + i, sizeof(Float4));
+            memcpy(&dy4, dy + i, sizeof(Float4));
+            x4 += dx4 * dt4;
+            y4 += dy4 * dt4;
+            memcpy(x + i, &x4, sizeof(Float4));
+            memcpy(y + i, &y4, sizeof(Float4));
+        }
+        for (; i < count; i++) {
+            x[i] += dx[i] * dt;
+            y[i] += dy[i] * dt;
+        }
+    }
+    // forget the bullets that left the screen, on any side, while
+    // BulletsManager_remove writes the same arrays
+    float *x = bullets_manager->x, *y = bullets_manager->y;
+    for (Uint32 i = 0; i < bullets_manager->count;) {
+        if (
+            x[i] + BULLET_WIDTH < 0 || x[i] > SCREEN_WIDTH
+            || y[i] + BULLET_HEIGHT < 0 || y[i] > SCREEN_HEIGHT
+        ) {
+            // the last bullet moves here, look at it next
+            BulletsManager_remove(bullets_manager, i);
+        } else {
+            i++;
+        }
+    }
+}
+
+/**
+ * `alpha` is the part (0 to 1) of the next simulation step that already passed.
+ */
+void BulletsManager_render_bullets(BulletsManager *bullets, float alpha) {
+    // bullets move in a straight line between two steps
+    float behind = (alpha - 1) * SIMULATION_STEP;
+    for (Uint32 i = 0; i < bullets->count; i++) {
+        SDL_Rect rect = {
+            roundf(bullets->x[i] + bullets->dx[i] * behind),
+            roundf(bullets->y[i] + bullets->dy[i] * behind),
+            BULLET_WIDTH,
+            BULLET_HEIGHT
+        };
+        SpriteBatch_draw(TEXTURE_LASER, NULL, rect);
+        if (DEBUG) {
+            SpriteBatch_draw_rect(rect, (SDL_Color){255, 0, 0, 128});
+        }
+    }
+}
+
+/*** Particles ***/
+
+/**
+ * Particles are small colored squares, alive for a fraction of a second.
+ * They are kept in one array per property, so that the update is a plain loop
+ * over floats.
+ */
+typedef struct {
+    Uint32 count;
+    float x[MAX_PARTICLES], y[MAX_PARTICLES]; // center
+    float dx[MAX_PARTICLES], dy[MAX_PARTICLES]; // pixels/second
+    float age[MAX_PARTICLES], lifetime[MAX_PARTICLES]; // seconds
+    float size[MAX_PARTICLES]; // pixels
+    SDL_Color color[MAX_PARTICLES];
+} Particles;
+
+Particles *Particles_new() {
+    Particles *particles = malloc(sizeof(Particles));
+    particles->count = 0;
+    return particles;
+}
+
+void Particles_destroy(Particles *particles) {
+    free(particles);
+}
+
+void Particles_clear(Particles *particles) {
+    particles->count = 0;
+}
+
+float random_float(float min, float max) {
+    return min + (max - min) * ((float)rand() / RAND_MAX);
+}
+
+/**
+ * Add a particle going in a random direction at `min_speed` to `max_speed`
+ * on top of (`dx`, `dy`). Dropped when there are too many particles already.
+ */
+void Particles_emit(
+    Particles *particles,
+    float x,
+    float y,
+    float dx,
+    float dy,
+    float min_speed,
+    float max_speed,
+    float lifetime,
+    float size,
+    SDL_Color color
+) {
+    if (particles->count == MAX_PARTICLES) {
+        return;
+    }
+    Uint32 i = particles->count++;
+    float angle = random_float(0, 2 * M_PI);
+    float speed = random_float(min_speed, max_speed);
+    particles->x[i] = x;
+    particles->y[i] = y;
+    particles->dx[i] = dx + cosf(angle) * speed;
+    particles->dy[i] = dy + sinf(angle) * speed;
+    particles->age[i] = 0;
+    // a bit of variety
+    particles->lifetime[i] = lifetime * random_float(0.5, 1);
+    particles->size[i] = size;
+    particles->color[i] = color;
+}
+
+/* Call this routine every simulation step */
+void Particles_update(Particles *particles, float dt) {
+    Uint32 count = particles->count;
+    float *restrict x = particles->x, *restrict y = particles->y;
+    float *restrict dx = particles->dx, *restrict dy = particles->dy;
+    float *restrict age = particles->age;
+    float drag = 1 - PARTICLES_DRAG * dt;
+    Float4 dt4 = {dt, dt, dt, dt}, drag4 = {drag, drag, drag, drag};
+    Uint32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        Float4 x4, y4, dx4, dy4, age4;
+        memcpy(&x4, x + i, sizeof(Float4));
+        memcpy(&y4, y + i, sizeof(Float4));
+        memcpy(&dx4, dx + i, sizeof(Float4));
+        memcpy(&dy4, dy + i, sizeof(Float4));
+        memcpy(&age4, age + i, sizeof(Float4));
+        x4 += dx4 * dt4;
+        y4 += dy4 * dt4;
+        dx4 *= drag4;
+        dy4 *= drag4;
+        age4 += dt4;
+        memcpy(x + i, &x4, sizeof(Float4));
+        memcpy(y + i, &y4, sizeof(Float4));
+        memcpy(dx + i, &dx4, sizeof(Float4));
+        memcpy(dy + i, &dy4, sizeof(Float4));
+        memcpy(age + i, &age4, sizeof(Float4));
+    }
+    for (; i < count; i++) {
+        x[i] += dx[i] * dt;
+        y[i] += dy[i] * dt;
+        dx[i] *= drag;
+        dy[i] *= drag;
+        age[i] += dt;
+    }
+    // drop the particles that are too old, keeping the others in order
+    Uint32 alive = 0;
+    for (Uint32 i = 0; i < count; i++) {
+        if (age[i] >= particles->lifetime[i]) {
+            continue;
         }
+        if (alive != i) {
+            x[alive] = x[i];
+            y[alive] = y[i];
+            dx[alive] = dx[i];
+            dy[alive] = dy[i];
+            age[alive] = age[i];
+            particles->lifetime[alive] = particles->lifetime[i];
+            particles->size[alive] = particles->size[i];
+            particles->color[alive] = particles->color[i];
+        }
+        alive++;
+    }
+    particles->count = alive;
+}
+
+/**
+ * Draw the particles, fading them out as they get older.
+ * `alpha` is the part (0 to 1) of the next simulation step that already passed.
+ */
+void Particles_render(Particles *particles, float alpha) {
+    // particles move in a straight line between two steps
+    float behind = (alpha - 1) * SIMULATION_STEP;
+    for (Uint32 i = 0; i < particles->count; i++) {
+        float half = particles->size[i] / 2;
+        float x = particles->x[i] + particles->dx[i] * behind;
+        float y = particles->y[i] + particles->dy[i] * behind;
+        SDL_Color color = particles->color[i];
+        color.a *= 1 - particles->age[i] / particles->lifetime[i];
+        SpriteBatch_fill_frect(x - half, y - half, particles->size[i], particles->size[i], color);
     }
 }
 
-void BulletsManager_render_bullets(BulletsManager *bullets, SDL_Renderer *renderer) {
-    for (size_t i = bullets->head; i != bullets->tail; i = (i + 1) % MAX_BULLETS_NUM) {
-        Bullet *b = &bullets->objs[i];
-        if (bullets->used[i]) {
-            Entity_render(b, renderer);
-        }
+void add_sparks(Particles *particles, float x, float y) {
+    for (int i = 0; i < SPARKS_COUNT; i++) {
+        Particles_emit(particles, x, y, 0, 0, 60, 240, 0.3, 2, (SDL_Color){255, 220, 120, 255});
+    }
+}
+
+void add_debris(Particles *particles, SDL_Rect rect) {
+    float x = rect.x + rect.w / 2.f, y = rect.y + rect.h / 2.f;
+    for (int i = 0; i < DEBRIS_COUNT; i++) {
+        SDL_Color color = rand() % 2
+            ? (SDL_Color){160, 160, 170, 255}
+            : (SDL_Color){255, 140, 40, 255};
+        Particles_emit(particles, x, y, 0, 0, 20, 150, 1.2, 3, color);
     }
 }
 
-/*** Spaceship ***/
+/*** Spaceships ***/
+
+#define MAX_SPACESHIPS (ENEMIES_COUNT + 1)
+_Static_assert(MAX_SPACESHIPS <= MAX_POOL_SIZE, "too many spaceships for a pool");
+
+/**
+ * All the spaceships, the player included, one array per component.
+ */
+typedef struct {
+    Pool pool;
+    Transform transform[MAX_SPACESHIPS];
+    Velocity velocity[MAX_SPACESHIPS];
+    Health health[MAX_SPACESHIPS];
+    Weapon weapon[MAX_SPACESHIPS];
+    Sprite sprite[MAX_SPACESHIPS];
+} Spaceships;
+
+void Spaceships_init(Spaceships *spaceships) {
+    Pool_init(&spaceships->pool, MAX_SPACESHIPS);
+}
+
+/**
+ * Add a spaceship, returns false when there is no room left.
+ */
+bool Spaceships_add(
+    Spaceships *spaceships,
+    Handle *handle,
+    SDL_Rect rect,
+    TextureType texture,
+    float dy,
+    Uint32 health
+) {
+    Uint32 i;
+    if (!Pool_add(&spaceships->pool, handle, &i)) {
+        return false;
+    }
+    Transform_init(&spaceships->transform[i], rect);
+    spaceships->velocity[i] = (Velocity){0, dy};
+    spaceships->health[i] = (Health){health, health};
+    spaceships->weapon[i] = (Weapon){0, false};
+    spaceships->sprite[i] = (Sprite){texture};
+    return true;
+}
 
-Spaceship *Spaceship_new(Entity *entity, Uint32 health) {
-    Spaceship *ss = malloc(sizeof(Spaceship));
-    ss->entity = entity;
-    ss->fire = false;
-    ss->reload = 0;
-    ss->next = NULL;
-    ss->max_health = ss->health = health;
-    return ss;
+void Spaceships_remove(Spaceships *spaceships, Uint32 i) {
+    Pool_remove(&spaceships->pool, i);
+    Uint32 last = spaceships->pool.count;
+    spaceships->transform[i] = spaceships->transform[last];
+    spaceships->velocity[i] = spaceships->velocity[last];
+    spaceships->health[i] = spaceships->health[last];
+    spaceships->weapon[i] = spaceships->weapon[last];
+    spaceships->sprite[i] = spaceships->sprite[last];
 }
 
-Spaceship *Spaceship_new_player_spaceship(SDL_Renderer *renderer) {
+bool Spaceships_add_player(Spaceships *spaceships, Handle *handle) {
     SDL_Rect rect = {
         (SCREEN_WIDTH - SPACESHIP_WIDTH) / 2,
         SCREEN_HEIGHT / 5. * 4,
         SPACESHIP_WIDTH,
         SPACESHIP_HEIGHT
     };
-    Entity *entity = Entity_new(
-        0, 0, 0, rect, TexturesCache_get(renderer, TEXTURE_SPACESHIP)
-    );
-    return Spaceship_new(entity, PLAYER_HEALTH);
-}
-
-void Spaceship_destroy(Spaceship *spaceship) {
-    Entity_destroy(spaceship->entity);
-    free(spaceship);
+    return Spaceships_add(spaceships, handle, rect, TEXTURE_SPACESHIP, 0, PLAYER_HEALTH);
 }
 
-bool Spaceship_is_dead(Spaceship *spaceship) {
-    return spaceship->health == 0;
+bool Spaceships_add_enemy(Spaceships *spaceships, SDL_Rect rect) {
+    return Spaceships_add(
+        spaceships, NULL, rect, TEXTURE_SPACESHIP_TURNED, ENEMY_SPEED, ENEMY_HEALTH
+    );
 }
 
-
-void Spaceship_take_damage(Spaceship *spaceship, Uint32 damage) {
-    if (spaceship->health >= damage) {
-        spaceship->health -= damage;
+void Health_take_damage(Health *health, Uint32 damage) {
+    if (health->health >= damage) {
+        health->health -= damage;
     } else {
-        spaceship->health = 0;
-    }
-}
-
-void Spaceship_decrease_reload_counter(Spaceship *spaceship) {
-    if (spaceship->reload > 0) {
-        spaceship->reload -= 1;
+        health->health = 0;
     }
 }
 
-/* Call this routine every tick/frame */
-void Spaceship_fire(Spaceship *spaceship, BulletsManager *bullets, SDL_Renderer *renderer, bool reverse) {
-    Spaceship_decrease_reload_counter(spaceship);
-    if (spaceship->fire && spaceship->reload == 0) {
-        BulletsManager_add_bullet(bullets, renderer, spaceship, reverse);
-        spaceship->reload = RELOAD_TIME;
+/* Call this routine every simulation step */
+void Spaceships_fire(
+    Spaceships *spaceships, Uint32 i, BulletsManager *bullets, bool reverse, float dt
+) {
+    Weapon *weapon = &spaceships->weapon[i];
+    weapon->reload = MAX(weapon->reload - dt, 0.f);
+    if (weapon->fire && weapon->reload == 0) {
+        BulletsManager_add_bullet(bullets, Transform_rect(&spaceships->transform[i]), reverse);
+        weapon->reload = RELOAD_TIME;
     }
 }
 
-void Spaceship_render_healthbar(Spaceship *spaceship, SDL_Renderer *renderer) {
-    SDL_Rect sr = spaceship->entity->rect;
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+void Spaceships_render_healthbar(Spaceships *spaceships, Uint32 i, float alpha) {
+    SDL_Rect sr = Transform_interpolated_rect(&spaceships->transform[i], alpha);
+    Health health = spaceships->health[i];
+    bool facing_up = !Sprite_facing_down(&spaceships->sprite[i]);
     SDL_Rect healthbar_empty;
     healthbar_empty.x = sr.x + (sr.w * 0.05);
-    if (spaceship->entity->rotation == 0) {
+    if (facing_up) {
         healthbar_empty.y = sr.y + sr.h + 10;
     } else {
         healthbar_empty.y = sr.y - 10;
     }
     healthbar_empty.w = sr.w * 0.9;
     healthbar_empty.h = 6;
-    SDL_RenderDrawRect(renderer, &healthbar_empty);
+    SpriteBatch_draw_rect(healthbar_empty, (SDL_Color){255, 255, 255, 255});
 
-    if (spaceship->health > 50) {
+    SDL_Color color;
+    if (health.health > 50) {
         // green healthbar
-        SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
-    } else if (spaceship->health > 30) {
+        color = (SDL_Color){0, 255, 0, 255};
+    } else if (health.health > 30) {
         // yellow healthbar
-        SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+        color = (SDL_Color){255, 255, 0, 255};
     } else {
         // red healthbar
-        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+        color = (SDL_Color){255, 0, 0, 255};
     }
 
     healthbar_empty.x = sr.x + (sr.w * 0.05) + 1;
-    if(spaceship->entity->rotation == 0) {
+    if(facing_up) {
         healthbar_empty.y = sr.y + sr.h + 10 + 1;
     } else {
         healthbar_empty.y = sr.y - 10 + 1;
     }
-    healthbar_empty.w = sr.w * 0.9 * (((double)spaceship->health) / spaceship->max_health) - 2;
+    healthbar_empty.w = sr.w * 0.9 * (((double)health.health) / health.max_health) - 2;
     healthbar_empty.h = 4;
-    SDL_RenderFillRect(renderer, &healthbar_empty);
+    if (healthbar_empty.w > 0) {
+        SpriteBatch_fill_rect(healthbar_empty, color);
+    }
+}
+
+void Spaceships_render(Spaceships *spaceships, float alpha) {
+    for (Uint32 i = 0; i < spaceships->pool.count; i++) {
+        Sprite_render(&spaceships->sprite[i], &spaceships->transform[i], alpha);
+        Spaceships_render_healthbar(spaceships, i, alpha);
+    }
 }
 
-void Spaceship_render(Spaceship *spaceship, SDL_Renderer *renderer) {
-    Entity_render(spaceship->entity, renderer);
-    Spaceship_render_healthbar(spaceship, renderer);
+/* Call this routine every simulation step */
+void emit_engine_trails(Spaceships *spaceships, Particles *particles, float dt) {
+    for (Uint32 i = 0; i < spaceships->pool.count; i++) {
+        if (random_float(0, 1) >= ENGINE_TRAIL_RATE * dt) {
+            continue;
+        }
+        SDL_Rect r = Transform_rect(&spaceships->transform[i]);
+        Velocity v = spaceships->velocity[i];
+        // out of the back of the spaceship, away from it
+        bool facing_up = !Sprite_facing_down(&spaceships->sprite[i]);
+        float y = facing_up ? r.y + r.h : r.y;
+        float dy = v.dy + (facing_up ? 80 : -80);
+        Particles_emit(
+            particles, r.x + r.w / 2.f, y, v.dx, dy, 0, 30, 0.4, 2, (SDL_Color){120, 180, 255, 200}
+        );
+    }
 }
 
-bool Spaceship_in_firing_range(Spaceship *shooter, Spaceship *victim, SDL_Renderer *renderer) {
-    SDL_Rect *shooter_r = &shooter->entity->rect, *victim_r = &victim->entity->rect;
+/* Where the bullets of an enemy go, from its front to the bottom of the screen */
+SDL_Rect firing_lane(SDL_Rect shooter_r) {
     SDL_Rect bullet_rect;
-    bullet_rect.x = shooter_r->x + (shooter_r->w / 2.) - (BULLET_WIDTH / 2.);
-    bullet_rect.y = shooter_r->y + shooter_r->h;
+    bullet_rect.x = shooter_r.x + (shooter_r.w / 2.) - (BULLET_WIDTH / 2.);
+    bullet_rect.y = shooter_r.y + shooter_r.h;
     bullet_rect.w = BULLET_WIDTH;
     bullet_rect.h = SCREEN_HEIGHT;
-    if (DEBUG) {
-        SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
-        SDL_RenderDrawRect(renderer, &bullet_rect);
-    }
-    return SDL_HasIntersection(victim_r, &bullet_rect);
-}
-
-/*** Explosion ***/
-
-typedef struct Explosion {
-    int x, y;
-    float start_scale;
-    float peak_scale;
-    int current_step;
-    int peak_step;
-    SDL_Texture *texture;
-    struct Explosion *next;
-} Explosion;
-
-Explosion *Explosion_new(int x, int y, float start_scale, float peak_scale, int peak_step, SDL_Texture *texture) {
-    Explosion *explosion = malloc(sizeof(Explosion));
-    explosion->x = x;
-    explosion->y = y;
-    explosion->start_scale = start_scale;
-    explosion->peak_scale = peak_scale;
-    explosion->current_step = 0;
-    explosion->peak_step = peak_step;
-    explosion->texture = texture;
-    explosion->next = NULL;
-    SoundChunkCache_play(SOUND_CHUNK_EXPLOSION);
-    return explosion;
-}
-
-void Explosion_destroy(Explosion *explosion) {
-    free(explosion);
-}
-
-float Explosion_get_scale_for_next_step(Explosion *explosion) {
-    if (explosion->current_step < explosion->peak_step) {
-        return explosion->start_scale + (explosion->current_step * (explosion->peak_scale - explosion->start_scale) / explosion->peak_step);
-    } else if (explosion->current_step == explosion->peak_step) {
-        return explosion->peak_scale;
-    } else {
-        return explosion->peak_scale - ((explosion->current_step - explosion->peak_step) * (explosion->peak_scale - explosion->start_scale) / explosion->peak_step);
+    return bullet_rect;
+}
+
+/* Shows the firing lanes of the enemies, for debugging */
+void render_firing_lanes(Spaceships *spaceships, Handle player) {
+    Uint32 player_index = MAX_SPACESHIPS;
+    Pool_lookup(&spaceships->pool, player, &player_index);
+    for (Uint32 i = 0; i < spaceships->pool.count; i++) {
+        if (i != player_index) {
+            SDL_Rect lane = firing_lane(Transform_rect(&spaceships->transform[i]));
+            SpriteBatch_draw_rect(lane, (SDL_Color){0, 0, 255, 255});
+        }
     }
 }
 
-Explosion *Explosion_step(Explosion *explosions, SDL_Renderer *renderer) {
-    Explosion *curr = explosions, *prev = NULL, *return_ = explosions;
-    while (curr != NULL) {
-        curr->current_step++;
-        if (curr->current_step > curr->peak_step) {
-            if (prev == NULL) {
-                prev = curr->next;
-                return_ = prev;
-            } else {
-                prev->next = curr->next;
+/*** Broadphase ***/
+
+/**
+ * Spaceships are sorted into a uniform grid over the screen before testing
+ * collisions, so that only the spaceships in the same cells are tested
+ * against each other. The grid is rebuilt every simulation step, once the
+ * spaceships moved and again once the destroyed ones are removed.
+ */
+#define GRID_CELL_SIZE 64
+#define GRID_COLUMNS ((SCREEN_WIDTH + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE)
+#define GRID_ROWS ((SCREEN_HEIGHT + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE)
+#define GRID_CELLS (GRID_COLUMNS * GRID_ROWS)
+// spaceships are smaller than a cell, so each of them is in at most 2x2 cells
+#define GRID_MAX_ENTRIES (MAX_SPACESHIPS * 4)
+
+/**
+ * Number of pairs of rectangles tested for collisions so far, shown when
+ * debugging.
+ */
+static Uint64 collision_tests = 0;
+
+typedef struct {
+    int first_column, last_column;
+    int first_row, last_row;
+} GridRange;
+
+typedef struct {
+    SDL_Rect rects[MAX_SPACESHIPS]; // of the spaceships
+    // the spaceships in cell `c` are `entries[cell_start[c]]` to `entries[cell_start[c + 1] - 1]`
+    Uint32 cell_start[GRID_CELLS + 1];
+    Uint32 entries[GRID_MAX_ENTRIES];
+    // to find every spaceship once, even when it is in several cells
+    Uint32 query;
+    Uint32 last_query[MAX_SPACESHIPS];
+} Grid;
+
+int clamp_int(int value, int min, int max) {
+    return MIN(MAX(value, min), max);
+}
+
+/**
+ * The cells overlapped by `rect`. Parts out of the screen belong to the
+ * cells on its edges.
+ */
+GridRange Grid_range(SDL_Rect rect) {
+    return (GridRange){
+        clamp_int(floorf((float)rect.x / GRID_CELL_SIZE), 0, GRID_COLUMNS - 1),
+        clamp_int(floorf((float)(rect.x + rect.w - 1) / GRID_CELL_SIZE), 0, GRID_COLUMNS - 1),
+        clamp_int(floorf((float)rect.y / GRID_CELL_SIZE), 0, GRID_ROWS - 1),
+        clamp_int(floorf((float)(rect.y + rect.h - 1) / GRID_CELL_SIZE), 0, GRID_ROWS - 1),
+    };
+}
+
+void Grid_init(Grid *grid) {
+    memset(grid, 0, sizeof(Grid));
+}
+
+void Grid_build(Grid *grid, Spaceships *spaceships) {
+    Uint32 count = spaceships->pool.count;
+    Uint32 *cell_start = grid->cell_start;
+    memset(cell_start, 0, sizeof(grid->cell_start));
+    // count the spaceships of every cell, shifted by one cell
+    for (Uint32 i = 0; i < count; i++) {
+        grid->rects[i] = Transform_rect(&spaceships->transform[i]);
+        GridRange range = Grid_range(grid->rects[i]);
+        for (int row = range.first_row; row <= range.last_row; row++) {
+            for (int column = range.first_column; column <= range.last_column; column++) {
+                cell_start[row * GRID_COLUMNS + column + 1]++;
             }
-            Explosion_destroy(curr);
-            curr = NULL;
-        } else {
-            SDL_Rect dst_rect;
-            SDL_QueryTexture(curr->texture, NULL, NULL, &dst_rect.w, &dst_rect.h);
-            float scale = Explosion_get_scale_for_next_step(curr);
-            dst_rect.w *= scale;
-            dst_rect.h *= scale;
-            dst_rect.x = curr->x - (dst_rect.w / 2.);
-            dst_rect.y = curr->y - (dst_rect.h / 2.);
-            SDL_RenderCopy(renderer, curr->texture, NULL, &dst_rect);
         }
-        prev = curr;
-        if (curr != NULL) {
-            curr = curr->next;
+    }
+    for (int cell = 0; cell < GRID_CELLS; cell++) {
+        cell_start[cell + 1] += cell_start[cell];
+    }
+    // fill the cells, spaceships stay in order within a cell
+    Uint32 next[GRID_CELLS];
+    memcpy(next, cell_start, sizeof(next));
+    for (Uint32 i = 0; i < count; i++) {
+        GridRange range = Grid_range(grid->rects[i]);
+        for (int row = range.first_row; row <= range.last_row; row++) {
+            for (int column = range.first_column; column <= range.last_column; column++) {
+                grid->entries[next[row * GRID_COLUMNS + column]++] = i;
+            }
         }
     }
-    return return_;
 }
 
-void Explosion_add(Explosion **explosions, Explosion *new_explosion) {
-    if (*explosions == NULL) {
-        *explosions = new_explosion;
-    } else {
-        Explosion *curr = *explosions;
-        while (curr->next != NULL) {
-            curr = curr->next;
+/**
+ * Put the spaceships that may overlap `rect` in `found` (room for
+ * MAX_SPACESHIPS), each of them once. Returns how many there are.
+ */
+Uint32 Grid_query(Grid *grid, SDL_Rect rect, Uint32 *found) {
+    Uint32 count = 0;
+    grid->query++;
+    GridRange range = Grid_range(rect);
+    for (int row = range.first_row; row <= range.last_row; row++) {
+        for (int column = range.first_column; column <= range.last_column; column++) {
+            int cell = row * GRID_COLUMNS + column;
+            for (Uint32 e = grid->cell_start[cell]; e < grid->cell_start[cell + 1]; e++) {
+                Uint32 i = grid->entries[e];
+                if (grid->last_query[i] != grid->query) {
+                    grid->last_query[i] = grid->query;
+                    found[count++] = i;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+/*** Explosions ***/
+
+#define MAX_EXPLOSIONS 32
+_Static_assert(MAX_EXPLOSIONS <= MAX_POOL_SIZE, "too many explosions for a pool");
+
+/**
+ * Explosions in progress, one array per property.
+ */
+typedef struct {
+    Pool pool;
+    SDL_Point center[MAX_EXPLOSIONS];
+    float start_scale[MAX_EXPLOSIONS];
+    float peak_scale[MAX_EXPLOSIONS];
+    float age[MAX_EXPLOSIONS]; // seconds since the start
+    float peak_time[MAX_EXPLOSIONS]; // seconds from the start to the peak scale
+    TextureType texture[MAX_EXPLOSIONS];
+} Explosions;
+
+void Explosions_init(Explosions *explosions) {
+    Pool_init(&explosions->pool, MAX_EXPLOSIONS);
+}
+
+/**
+ * Start an explosion. It is dropped when there are too many already.
+ */
+void Explosions_add(
+    Explosions *explosions, int x, int y, float start_scale, float peak_scale, float peak_time, TextureType texture
+) {
+    Uint32 i;
+    if (!Pool_add(&explosions->pool, NULL, &i)) {
+        return;
+    }
+    explosions->center[i] = (SDL_Point){x, y};
+    explosions->start_scale[i] = start_scale;
+    explosions->peak_scale[i] = peak_scale;
+    explosions->age[i] = 0;
+    explosions->peak_time[i] = peak_time;
+    explosions->texture[i] = texture;
+}
+
+void Explosions_remove(Explosions *explosions, Uint32 i) {
+    Pool_remove(&explosions->pool, i);
+    Uint32 last = explosions->pool.count;
+    explosions->center[i] = explosions->center[last];
+    explosions->start_scale[i] = explosions->start_scale[last];
+    explosions->peak_scale[i] = explosions->peak_scale[last];
+    explosions->age[i] = explosions->age[last];
+    explosions->peak_time[i] = explosions->peak_time[last];
+    explosions->texture[i] = explosions->texture[last];
+}
+
+/**
+ * The scale grows linearly from the start scale to the peak scale.
+ */
+float Explosions_get_scale(Explosions *explosions, Uint32 i, float age) {
+    float progress = MIN(age / explosions->peak_time[i], 1.f);
+    return explosions->start_scale[i] + progress * (explosions->peak_scale[i] - explosions->start_scale[i]);
+}
+
+/* Call this routine every simulation step */
+void Explosions_update(Explosions *explosions, float dt) {
+    for (Uint32 i = 0; i < explosions->pool.count;) {
+        explosions->age[i] += dt;
+        if (explosions->age[i] > explosions->peak_time[i]) {
+            // the last explosion moves here, look at it next
+            Explosions_remove(explosions, i);
+        } else {
+            i++;
         }
-        curr->next = new_explosion;
     }
 }
 
-Explosion *get_spaceship_explosion(SDL_Renderer *renderer, Spaceship *spaceship) {
-    return Explosion_new(
-        spaceship->entity->rect.x + (spaceship->entity->rect.w / 2.),
-        spaceship->entity->rect.y + (spaceship->entity->rect.h / 2.),
+/**
+ * `alpha` is the part (0 to 1) of the next simulation step that already passed.
+ */
+void Explosions_render(Explosions *explosions, float alpha) {
+    for (Uint32 i = 0; i < explosions->pool.count; i++) {
+        SDL_Rect dst_rect = TextureAtlas_get_rect(explosions->texture[i]);
+        float scale = Explosions_get_scale(explosions, i, explosions->age[i] + alpha * SIMULATION_STEP);
+        dst_rect.w *= scale;
+        dst_rect.h *= scale;
+        dst_rect.x = explosions->center[i].x - (dst_rect.w / 2.);
+        dst_rect.y = explosions->center[i].y - (dst_rect.h / 2.);
+        SpriteBatch_draw(explosions->texture[i], NULL, dst_rect);
+    }
+}
+
+void add_spaceship_explosion(Explosions *explosions, SDL_Rect rect) {
+    play_sound(SOUND_CHUNK_EXPLOSION);
+    Explosions_add(
+        explosions,
+        rect.x + (rect.w / 2.),
+        rect.y + (rect.h / 2.),
         0.1,
         1.5,
-        30,
-        TexturesCache_get(renderer, TEXTURE_EXPLOSION)
+        EXPLOSION_PEAK_TIME,
+        TEXTURE_EXPLOSION
     );
 }
 
-Uint32 apply_bullet_hits(Spaceship *spaceship, BulletsManager *bullets_manager) {
+/**
+ * Spaceships take damage from the bullets that hit them. `grid` must hold
+ * the spaceships as they are now.
+ */
+Uint32 apply_bullet_hits(
+    Spaceships *spaceships, Grid *grid, BulletsManager *bullets_manager, Particles *particles
+) {
     Uint32 killed = 0;
-    Spaceship *curr = spaceship;
-    while (curr != NULL) {
-        for (
-            size_t i = bullets_manager->head;
-            i != bullets_manager->tail;
-            i = (i + 1) % MAX_BULLETS_NUM
-        ) {
-            if (!bullets_manager->used[i]) { continue; }
-            SDL_Rect *ship_rect = &curr->entity->rect;
-            SDL_Rect *bullet_rect = &bullets_manager->objs[i].rect;
-            if (SDL_HasIntersection(ship_rect, bullet_rect)) {
-                Uint32 bullet_damage;
-                if (rand() % 2) {
-                    bullet_damage = BULLET_DAMAGE + (rand() % BULLET_DAMAGE / 3);
-                } else {
-                    bullet_damage = BULLET_DAMAGE - (rand() % BULLET_DAMAGE / 3);
-                }
-                Spaceship_take_damage(curr, bullet_damage);
-                bullets_manager->used[i] = false;
+    Uint32 found[MAX_SPACESHIPS];
+    for (Uint32 i = 0; i < bullets_manager->count;) {
+        SDL_Rect bullet_rect = BulletsManager_rect(bullets_manager, i);
+        // a bullet hits only one spaceship, the first one
+        Uint32 target = MAX_SPACESHIPS;
+        Uint32 found_count = Grid_query(grid, bullet_rect, found);
+        for (Uint32 f = 0; f < found_count; f++) {
+            collision_tests++;
+            if (found[f] < target && SDL_HasIntersection(&grid->rects[found[f]], &bullet_rect)) {
+                target = found[f];
             }
         }
-        curr = curr->next;
+        if (target == MAX_SPACESHIPS) {
+            i++;
+            continue;
+        }
+        Uint32 bullet_damage;
+        if (rand() % 2) {
+            bullet_damage = BULLET_DAMAGE + (rand() % BULLET_DAMAGE / 3);
+        } else {
+            bullet_damage = BULLET_DAMAGE - (rand() % BULLET_DAMAGE / 3);
+        }
+        Health_take_damage(&spaceships->health[target], bullet_damage);
+        add_sparks(
+            particles,
+            bullet_rect.x + bullet_rect.w / 2.f,
+            bullets_manager->dy[i] > 0 ? bullet_rect.y + bullet_rect.h : bullet_rect.y
+        );
+        // the last bullet moves here, look at it next
+        BulletsManager_remove(bullets_manager, i);
     }
     return killed;
 }
@@ -655,49 +2150,42 @@ Uint32 apply_bullet_hits(Spaceship *spaceship, BulletsManager *bullets_manager)
 /* Remove any spaceships (except for the player) with 0 health and generate explosions for them.
  * Returns the number of killed ships (excluding the player).
  */
-Uint32 Spaceship_clean_up(Spaceship *spaceships, Explosion **explosions, SDL_Renderer *renderer) {
-    Uint32 killed = 0;
-    Spaceship *curr = spaceships, *prev = NULL;
-    while (curr != NULL) {
-        if (Spaceship_is_dead(curr) && curr != spaceships) {
+Uint32 Spaceships_clean_up(
+    Spaceships *spaceships, Handle player, Explosions *explosions, Particles *particles
+) {
+    Uint32 killed = 0, player_index = MAX_SPACESHIPS;
+    Pool_lookup(&spaceships->pool, player, &player_index);
+    for (Uint32 i = 0; i < spaceships->pool.count;) {
+        if (spaceships->health[i].health == 0 && i != player_index) {
             killed++;
-            Explosion *new_explosion = get_spaceship_explosion(renderer, curr);
-            Explosion_add(explosions, new_explosion);
-            // prev is not NULL because we skip the player which is always the first element of the list
-            prev->next = curr->next;
-            Spaceship_destroy(curr);
-            if (prev->next == NULL) {
-                prev = prev->next;
-                curr = NULL;
-            } else {
-                prev = prev->next;
-                curr = prev->next;
-            }
+            add_spaceship_explosion(explosions, Transform_rect(&spaceships->transform[i]));
+            add_debris(particles, Transform_rect(&spaceships->transform[i]));
+            Spaceships_remove(spaceships, i);
+            // the last spaceship moves here, maybe the player
+            Pool_lookup(&spaceships->pool, player, &player_index);
         } else {
-            prev = curr;
-            curr = curr->next;
+            i++;
         }
     }
     return killed;
 }
 
-void spawn_enemies(Spaceship *spaceship, SDL_Renderer *renderer) {
-    Spaceship *curr = spaceship->next, *last = spaceship;
+void spawn_enemies(Spaceships *spaceships, Handle player) {
+    Uint32 player_index = MAX_SPACESHIPS;
+    Pool_lookup(&spaceships->pool, player, &player_index);
     Uint32 count = 0;
-    while(curr != NULL) {
-        count++;
-        if (curr != spaceship) {
-            SDL_Rect r = curr->entity->rect;
-            if (r.y + r.h < 0 || r.y - r.h > SCREEN_HEIGHT) {
-                Spaceship *to_destroy = curr;
-                curr = curr->next;
-                last->next = curr;
-                Spaceship_destroy(to_destroy);
-            }
+    for (Uint32 i = 0; i < spaceships->pool.count;) {
+        if (i == player_index) {
+            i++;
+            continue;
         }
-        if (curr != NULL) {
-            last = curr;
-            curr = curr->next;
+        count++;
+        SDL_Rect r = Transform_rect(&spaceships->transform[i]);
+        if (r.y + r.h < 0 || r.y - r.h > SCREEN_HEIGHT) {
+            Spaceships_remove(spaceships, i);
+            Pool_lookup(&spaceships->pool, player, &player_index);
+        } else {
+            i++;
         }
     }
 
@@ -705,7 +2193,6 @@ void spawn_enemies(Spaceship *spaceship, SDL_Renderer *renderer) {
         return;
     }
 
-    curr = last;
     Uint32 enemies_to_spawn = MIN(ENEMIES_COUNT - count, MAX_SPAWN);
     for (Uint32 i = 0; i < enemies_to_spawn; i++) {
         SDL_Rect rect;
@@ -713,70 +2200,89 @@ void spawn_enemies(Spaceship *spaceship, SDL_Renderer *renderer) {
         rect.h = SPACESHIP_HEIGHT / 1.5;
         rect.x = rand() % (SCREEN_WIDTH - rect.w);
         rect.y = -rect.h;
-        Entity *entity = Entity_new(180, 0, 1, rect, TexturesCache_get(renderer, TEXTURE_SPACESHIP));
-        curr->next = Spaceship_new(entity, ENEMY_HEALTH);
-        curr = curr->next;
-    }
-}
-
-void make_enemies_shoot(Spaceship *spaceship, BulletsManager *bullets_manager, SDL_Renderer *renderer) {
-    Spaceship *curr = spaceship->next;
-    while (curr != NULL) {
-        curr->fire = false;
-        if (rand() % 500 == 0) {
-            curr->fire = true;
-            Spaceship *curr2 = spaceship->next;
-            while(curr2 != NULL) {
-                if (curr2 != curr) {
-                    if (Spaceship_in_firing_range(curr, curr2, renderer)) {
-                        curr->fire = false;
+        Spaceships_add_enemy(spaceships, rect);
+    }
+}
+
+/**
+ * Call this routine every simulation step. Enemies do not shoot when another
+ * enemy is in their firing lane, which is looked up in `grid`, rebuilt first.
+ */
+void make_enemies_shoot(
+    Spaceships *spaceships, Grid *grid, Handle player, BulletsManager *bullets_manager, float dt
+) {
+    Uint32 player_index = MAX_SPACESHIPS;
+    Pool_lookup(&spaceships->pool, player, &player_index);
+    // spaceships may have been removed since the last build
+    Grid_build(grid, spaceships);
+    Uint32 found[MAX_SPACESHIPS];
+    for (Uint32 i = 0; i < spaceships->pool.count; i++) {
+        if (i == player_index) {
+            continue;
+        }
+        Weapon *weapon = &spaceships->weapon[i];
+        weapon->fire = false;
+        if (rand() < RAND_MAX * (ENEMY_FIRE_RATE * dt)) {
+            weapon->fire = true;
+            SDL_Rect lane = firing_lane(grid->rects[i]);
+            Uint32 found_count = Grid_query(grid, lane, found);
+            for (Uint32 f = 0; f < found_count; f++) {
+                Uint32 j = found[f];
+                if (j != i && j != player_index) {
+                    collision_tests++;
+                    if (SDL_HasIntersection(&grid->rects[j], &lane)) {
+                        weapon->fire = false;
                         break;
                     }
                 }
-                curr2 = curr2->next;
             }
         }
-        Spaceship_fire(curr, bullets_manager, renderer, true);
-        curr = curr->next;
+        Spaceships_fire(spaceships, i, bullets_manager, true, dt);
     }
 }
 
-void move_spaceships(Spaceship *spaceship) {
-    Spaceship *curr = spaceship, *other;
-    while (curr != NULL) {
-        Entity_move(curr->entity);
-        curr = curr->next;
+/**
+ * Call this routine every simulation step. Rebuilds `grid` once the
+ * spaceships moved.
+ */
+void move_spaceships(Spaceships *spaceships, Grid *grid, Handle player, float dt) {
+    Uint32 count = spaceships->pool.count;
+    for (Uint32 i = 0; i < count; i++) {
+        Transform_move(&spaceships->transform[i], &spaceships->velocity[i], dt);
     }
     // block player from going out of bounds
-    SDL_Rect *player_r = &spaceship->entity->rect;
-    player_r->x = MAX(player_r->x, -(player_r->w / 2.));
-    player_r->x = MIN(player_r->x, SCREEN_WIDTH - (player_r->w / 2.));
-    player_r->y = MAX(player_r->y, -(player_r->h / 2.));
-    player_r->y = MIN(player_r->y, SCREEN_HEIGHT - player_r->h);
+    Uint32 p;
+    if (Pool_lookup(&spaceships->pool, player, &p)) {
+        Transform *t = &spaceships->transform[p];
+        t->x = MAX(t->x, -(t->w / 2.f));
+        t->x = MIN(t->x, SCREEN_WIDTH - (t->w / 2.f));
+        t->y = MAX(t->y, -(t->h / 2.f));
+        t->y = MIN(t->y, SCREEN_HEIGHT - (float)t->h);
+    }
+    Grid_build(grid, spaceships);
     // apply damage for spaceships that collide
-    curr = spaceship;
-    while (curr != NULL) {
-        if (Spaceship_is_dead(curr)) {
-            curr=curr->next;
+    Health *health = spaceships->health;
+    Uint32 found[MAX_SPACESHIPS];
+    for (Uint32 i = 0; i < count; i++) {
+        if (health[i].health == 0) {
             continue;
         }
-        other = spaceship;
-        while (other != NULL) {
-            if (curr != other && !Spaceship_is_dead(other)) {
-                if (SDL_HasIntersection(&curr->entity->rect, &other->entity->rect)) {
-                    Uint32 damage = MIN(curr->health, other->health);
-                    Spaceship_take_damage(curr, damage);
-                    Spaceship_take_damage(other, damage);
+        Uint32 found_count = Grid_query(grid, grid->rects[i], found);
+        for (Uint32 f = 0; f < found_count; f++) {
+            Uint32 j = found[f];
+            if (i != j && health[j].health != 0) {
+                collision_tests++;
+                if (SDL_HasIntersection(&grid->rects[i], &grid->rects[j])) {
+                    Uint32 damage = MIN(health[i].health, health[j].health);
+                    Health_take_damage(&health[i], damage);
+                    Health_take_damage(&health[j], damage);
                 }
             }
-            other = other->next;
         }
-        curr = curr->next;
     }
 }
 
-
-bool handle_input(Spaceship *player) {
+bool handle_input(Velocity *velocity, Weapon *weapon) {
     SDL_Event event;
     while(SDL_PollEvent(&event)) {
         switch(event.type) {
@@ -790,19 +2296,19 @@ bool handle_input(Spaceship *player) {
                     case SDL_SCANCODE_Q:
                         return false;
                     case SDL_SCANCODE_UP:
-                        player->entity->dy -= PLAYER_SPEED;
+                        velocity->dy -= PLAYER_SPEED;
                         break;
                     case SDL_SCANCODE_DOWN:
-                        player->entity->dy += PLAYER_SPEED;
+                        velocity->dy += PLAYER_SPEED;
                         break;
                     case SDL_SCANCODE_LEFT:
-                        player->entity->dx -= PLAYER_SPEED;
+                        velocity->dx -= PLAYER_SPEED;
                         break;
                     case SDL_SCANCODE_RIGHT:
-                        player->entity->dx += PLAYER_SPEED;
+                        velocity->dx += PLAYER_SPEED;
                         break;
                     case SDL_SCANCODE_SPACE:
-                        player->fire = true;
+                        weapon->fire = true;
                         break;
                     default: ;
                 }
@@ -810,19 +2316,19 @@ bool handle_input(Spaceship *player) {
             case SDL_KEYUP:
                 switch (event.key.keysym.scancode) {
                     case SDL_SCANCODE_UP:
-                        player->entity->dy += PLAYER_SPEED;
+                        velocity->dy += PLAYER_SPEED;
                         break;
                     case SDL_SCANCODE_DOWN:
-                        player->entity->dy -= PLAYER_SPEED;
+                        velocity->dy -= PLAYER_SPEED;
                         break;
                     case SDL_SCANCODE_LEFT:
-                        player->entity->dx += PLAYER_SPEED;
+                        velocity->dx += PLAYER_SPEED;
                         break;
                     case SDL_SCANCODE_RIGHT:
-                        player->entity->dx -= PLAYER_SPEED;
+                        velocity->dx -= PLAYER_SPEED;
                         break;
                     case SDL_SCANCODE_SPACE:
-                        player->fire = false;
+                        weapon->fire = false;
                         break;
                     default: ;
                 }
@@ -834,17 +2340,39 @@ bool handle_input(Spaceship *player) {
 }
 
 
-void cap_fps(Uint32 max_fps) {
-    static Uint32 ticks = 0;
-    if (ticks == 0) { ticks = SDL_GetTicks(); }
-    Uint32 new_ticks = SDL_GetTicks();
-    Uint32 default_ = 1000. / max_fps;  // delay between frames assuming 0ms to calculate each frame
-    Uint32 diff = new_ticks - ticks;  // time to calculate last frame
-    if (default_ > diff) {
-        // only wait when the wait time is > 0
-        SDL_Delay(default_ - diff);
-    }
-    ticks = new_ticks;
+/*** Clock ***/
+
+/**
+ * Splits the time between frames into simulation steps of `SIMULATION_STEP`
+ * seconds. The rest is carried over to the next frame.
+ */
+typedef struct {
+    Uint64 last; // performance counter at the last frame
+    double lag; // seconds not simulated yet
+} Clock;
+
+void Clock_init(Clock *clock) {
+    clock->last = SDL_GetPerformanceCounter();
+    clock->lag = 0;
+}
+
+/* Call this routine every frame, returns the number of simulation steps to run */
+Uint32 Clock_tick(Clock *clock) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    clock->lag += (double)(now - clock->last) / SDL_GetPerformanceFrequency();
+    clock->last = now;
+    clock->lag = MIN(clock->lag, MAX_SIMULATION_LAG);
+    Uint32 steps = clock->lag / SIMULATION_STEP;
+    clock->lag -= steps * SIMULATION_STEP;
+    return steps;
+}
+
+/**
+ * The part (0 to 1) of the next simulation step that already passed, frames
+ * are rendered that far between the last two steps.
+ */
+float Clock_alpha(Clock *clock) {
+    return clock->lag / SIMULATION_STEP;
 }
 
 /*** Fonts ***/
@@ -962,47 +2490,61 @@ Font ken_pixel_font = {ken_pixel_font_chars, ' ', '}', TEXTURE_FONT_KEN_PIXEL_WH
 
 /*** Text ***/
 
+#define TEXT_LAYOUT_MAX_LENGTH 64
+
+/**
+ * A string laid out with a font: where every character is in the atlas and
+ * where it goes relative to the top left corner of the string. The layout is
+ * only computed again when the string changes, so text which is set every
+ * frame but rarely changes (score, fps) costs a string comparison.
+ */
 typedef struct {
-    char *text;
-    int x, y;
-    float scale;
     Font *font;
-} Text;
-
-Uint32 Text_calculate_width(Text *text) {
-    Uint32 width = 0, i = 0;
-    char c;
-    while((c = text->text[i++]) != '\0') {
-        width += text->scale * text->font->font_chars[c - text->font->first_char].rect.w;
-    }
-    return width;
-}
+    float scale;
+    char text[TEXT_LAYOUT_MAX_LENGTH];
+    Uint32 length;
+    SDL_Rect src[TEXT_LAYOUT_MAX_LENGTH]; // characters in the atlas
+    SDL_Rect dst[TEXT_LAYOUT_MAX_LENGTH]; // relative to the top left corner
+    Uint32 width, height;
+} TextLayout;
 
-Uint32 Text_calculate_height(Text *text) {
-    Uint32 height = 0, i = 0;
-    char c;
-    while((c = text->text[i++]) != '\0') {
-        height = MAX(height, text->scale * text->font->font_chars[c - text->font->first_char].rect.h);
+/**
+ * Set the string of the layout, it is laid out again only if it changed.
+ * Longer strings are cut to fit.
+ */
+void TextLayout_set(TextLayout *layout, const char *text) {
+    if (layout->length > 0 && strncmp(layout->text, text, TEXT_LAYOUT_MAX_LENGTH - 1) == 0) {
+        return;
     }
-    return height;
-}
-
-void Text_write_to_screen(SDL_Renderer *renderer, Text *text) {
-    Font *font = text->font;
+    Font *font = layout->font;
+    SDL_Rect atlas_rect = TextureAtlas_get_rect(font->texture_type);
+    Uint32 i = 0;
+    int w = 0, h = 0;
     char c;
-    int i = 0, w = text->x;
-    while ((c = text->text[i++]) != '\0') {
+    for (; i < TEXT_LAYOUT_MAX_LENGTH - 1 && (c = text[i]) != '\0'; i++) {
         if (c < font->first_char || c > font->last_char) {
             printf("Warning: can't print char: %c (%d)\n", c, c);
+            c = font->first_char;
         }
-        SDL_Rect *src_rect = &font->font_chars[c - font->first_char].rect;
-        SDL_Rect dst_rect;
-        dst_rect.x = w;
-        dst_rect.y = text->y;
-        dst_rect.w = src_rect->w * text->scale;
-        dst_rect.h = src_rect->h * text->scale;
-        SDL_RenderCopy(renderer, TexturesCache_get(renderer, text->font->texture_type), src_rect, &dst_rect);
-        w += dst_rect.w;
+        SDL_Rect rect = font->font_chars[c - font->first_char].rect;
+        layout->text[i] = text[i];
+        layout->src[i] = (SDL_Rect){atlas_rect.x + rect.x, atlas_rect.y + rect.y, rect.w, rect.h};
+        layout->dst[i] = (SDL_Rect){w, 0, rect.w * layout->scale, rect.h * layout->scale};
+        w += layout->dst[i].w;
+        h = MAX(h, layout->dst[i].h);
+    }
+    layout->text[i] = '\0';
+    layout->length = i;
+    layout->width = w;
+    layout->height = h;
+}
+
+void TextLayout_render(TextLayout *layout, int x, int y) {
+    for (Uint32 i = 0; i < layout->length; i++) {
+        SDL_Rect dst = layout->dst[i];
+        SpriteBatch_add_quad(
+            x + dst.x, y + dst.y, dst.w, dst.h, layout->src[i], (SDL_Color){255, 255, 255, 255}
+        );
     }
 }
 
@@ -1012,75 +2554,117 @@ void Text_write_to_screen(SDL_Renderer *renderer, Text *text) {
  * Star intended to be used in background of the game.
  */
 typedef struct {
-    int x, y;
-    int speed;
+    float x, y, prev_y;
+    float speed; // pixels/second
 } Star;
 
-static int rand_star_speed() {
-    return 1 + (rand() % STARS_MAX_SPEED);
+static float rand_star_speed() {
+    return STARS_SPEED_STEP * (1 + (rand() % (STARS_MAX_SPEED / STARS_SPEED_STEP)));
 }
 
+static Star stars[STARS_COUNT];
+
 /**
- * Call this function to render the stars in the background. Stars count
- * and max speed can be adjusted by setting `STARS_COUNT` and `STARS_MAX_SPEED`.
+ * Call this function every simulation step to move the stars in the background.
+ * Stars count and max speed can be adjusted by setting `STARS_COUNT` and
+ * `STARS_MAX_SPEED`.
  */
-void render_stars(SDL_Renderer *renderer) {
-    static Star stars[STARS_COUNT];
+void update_stars(float dt) {
     static bool initialized = false;
     if (!initialized) {
         for (int i = 0; i < STARS_COUNT; i++) {
             stars[i].x = rand() % SCREEN_WIDTH;
-            stars[i].y = rand() % SCREEN_HEIGHT;
+            stars[i].y = stars[i].prev_y = rand() % SCREEN_HEIGHT;
             stars[i].speed = rand_star_speed();
         }
         initialized = true;
     }
     for (int i = 0; i < STARS_COUNT; i++) {
-        stars[i].y += stars[i].speed;
-        if (stars[i].y - stars[i].speed > SCREEN_HEIGHT) {
-            stars[i].y = 0;
+        stars[i].prev_y = stars[i].y;
+        stars[i].y += stars[i].speed * dt;
+        if (stars[i].y - stars[i].speed / STARS_SPEED_STEP > SCREEN_HEIGHT) {
+            stars[i].y = stars[i].prev_y = 0;
             stars[i].x = rand() % SCREEN_WIDTH;
             stars[i].speed = rand_star_speed();
         }
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        SDL_RenderDrawLine(renderer, stars[i].x, stars[i].y, stars[i].x, stars[i].y - stars[i].speed);
     }
 }
 
 /**
- * Render FPS in the top right corner. The actual FPS calculation is rather inaccurate.
+ * Render the stars with a tail as long as the distance they move in a step.
  */
-void render_fps(SDL_Renderer *renderer) {
-    static Uint32 ticks = 0, fps = 0;
-    if (ticks == 0) {
-        ticks = SDL_GetTicks();
+void render_stars(float alpha) {
+    for (int i = 0; i < STARS_COUNT; i++) {
+        int y = stars[i].prev_y + (stars[i].y - stars[i].prev_y) * alpha;
+        int tail = stars[i].speed / STARS_SPEED_STEP;
+        // a line from y - tail to y, both included
+        SpriteBatch_fill_rect(
+            (SDL_Rect){stars[i].x, y - tail, 1, tail + 1}, (SDL_Color){255, 255, 255, 255}
+        );
     }
-    Uint32 diff = SDL_GetTicks() - ticks;
-    if (diff != 0) {
-        fps = 1000. / diff;
-        if (fps > MAX_FPS) {
-            fps = MAX_FPS;
-        }
+}
+
+/**
+ * Render FPS in the top right corner, counted over the last second.
+ */
+void render_fps() {
+    static Uint64 start = 0;
+    static Uint32 frames = 0, fps = 0;
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (start == 0) {
+        start = now;
+    }
+    frames++;
+    if (now - start >= SDL_GetPerformanceFrequency()) {
+        fps = frames * SDL_GetPerformanceFrequency() / (now - start);
+        frames = 0;
+        start = now;
     }
+    static TextLayout layout = {.font = &ken_pixel_font, .scale = 1./2};
     char fps_str[20]; sprintf(fps_str, "fps: %d", fps);
-    Text text = {fps_str, 0, 10, 1./2, &ken_pixel_font};
-    Uint32 width = Text_calculate_width(&text);
-    text.x = SCREEN_WIDTH - width - 10;
-    Text_write_to_screen(renderer, &text);
-    ticks = SDL_GetTicks();
+    TextLayout_set(&layout, fps_str);
+    TextLayout_render(&layout, SCREEN_WIDTH - layout.width - 10, 10);
+}
+
+/**
+ * Render the number of collision tests and of draw calls since the last call,
+ * the memory used by resources and the voices playing, below the fps. Draw calls are made when
+ * the frame ends, so these are the ones of the previous frame.
+ */
+void render_debug_counters() {
+    static Uint64 last_tests = 0, last_draw_calls = 0;
+    static TextLayout tests = {.font = &ken_pixel_font, .scale = 1./2};
+    static TextLayout calls = {.font = &ken_pixel_font, .scale = 1./2};
+    static TextLayout resources = {.font = &ken_pixel_font, .scale = 1./2};
+    static TextLayout voices = {.font = &ken_pixel_font, .scale = 1./2};
+    char str[40];
+    sprintf(str, "tests: %lu", (unsigned long)(collision_tests - last_tests));
+    TextLayout_set(&tests, str);
+    TextLayout_render(&tests, SCREEN_WIDTH - tests.width - 10, 30);
+    sprintf(str, "draw calls: %lu", (unsigned long)(draw_calls - last_draw_calls));
+    TextLayout_set(&calls, str);
+    TextLayout_render(&calls, SCREEN_WIDTH - calls.width - 10, 50);
+    sprintf(str, "resources: %lu KB", (unsigned long)(Resources_resident_bytes() / 1024));
+    TextLayout_set(&resources, str);
+    TextLayout_render(&resources, SCREEN_WIDTH - resources.width - 10, 70);
+    VoicesStats stats = Voices_get_stats();
+    sprintf(str, "voices: %u/%d", stats.playing, VOICES_COUNT);
+    TextLayout_set(&voices, str);
+    TextLayout_render(&voices, SCREEN_WIDTH - voices.width - 10, 90);
+    last_tests = collision_tests;
+    last_draw_calls = draw_calls;
 }
 
 /**
  * Render score in the middle of the screen.
  */
-void render_score(SDL_Renderer *renderer, Uint32 score) {
-    char score_str[10]; sprintf(score_str, "%d", score);
-    Text score_text = { score_str, 0, 0, 1.5, &ken_pixel_font };
-    Uint32 width = Text_calculate_width(&score_text);
-    Uint32 height = Text_calculate_height(&score_text);
-    score_text.x = (SCREEN_WIDTH - width) / 2.;
-    score_text.y = (SCREEN_HEIGHT - height) / 2.;
-    Text_write_to_screen(renderer, &score_text);
+void render_score(Uint32 score) {
+    static TextLayout layout = {.font = &ken_pixel_font, .scale = 1.5};
+    char score_str[12]; sprintf(score_str, "%u", score);
+    TextLayout_set(&layout, score_str);
+    TextLayout_render(
+        &layout, (SCREEN_WIDTH - layout.width) / 2., (SCREEN_HEIGHT - layout.height) / 2.
+    );
 }
 
 /**
@@ -1088,6 +2672,13 @@ void render_score(SDL_Renderer *renderer, Uint32 score) {
  * Returns true if the user wants to play again.
  */
 bool show_game_over_screen(SDL_Renderer *renderer, Uint32 score) {
+    TextLayout game_over_text = {.font = &ken_pixel_font, .scale = 1.3};
+    TextLayout_set(&game_over_text, "GAME OVER");
+    int game_over_text_y = (SCREEN_HEIGHT - game_over_text.height) / 3.;
+    TextLayout hint_text = {.font = &ken_pixel_font, .scale = 1./2};
+    TextLayout_set(&hint_text, "(Q)uit  or  (R)estart");
+
+    Clock clock; Clock_init(&clock);
     while (1) {
         SDL_Event event;
         while(SDL_PollEvent(&event)) {
@@ -1107,114 +2698,362 @@ bool show_game_over_screen(SDL_Renderer *renderer, Uint32 score) {
             }
         }
 
+        for (Uint32 steps = Clock_tick(&clock); steps > 0; steps--) {
+            update_stars(SIMULATION_STEP);
+        }
+        Resources_update();
+        Voices_update();
+
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
-        render_stars(renderer);
-
-        // Render "GAME OVER"
-        Text game_over_text = {"GAME OVER", 0, 0, 1.3, &ken_pixel_font};
-        Uint32 game_over_text_width = Text_calculate_width(&game_over_text);
-        Uint32 game_over_text_height = Text_calculate_height(&game_over_text);
-        game_over_text.x = (SCREEN_WIDTH - game_over_text_width) / 2.;
-        game_over_text.y = (SCREEN_HEIGHT - game_over_text_height) / 3.;
-        Text_write_to_screen(renderer, &game_over_text);
-
-        // Render hint
-        Text hint_text = {
-            "(Q)uit  or  (R)estart",
-            0,
-            game_over_text.y + game_over_text_height + 10,
-            1./2,
-            &ken_pixel_font
-        };
-        hint_text.x = (SCREEN_WIDTH - Text_calculate_width(&hint_text)) / 2.;
-        Text_write_to_screen(renderer, &hint_text);
+        render_stars(Clock_alpha(&clock));
+
+        TextLayout_render(
+            &game_over_text, (SCREEN_WIDTH - game_over_text.width) / 2., game_over_text_y
+        );
+        TextLayout_render(
+            &hint_text,
+            (SCREEN_WIDTH - hint_text.width) / 2.,
+            game_over_text_y + game_over_text.height + 10
+        );
 
-        render_score(renderer, score);
+        render_score(score);
+        SpriteBatch_flush(renderer);
         SDL_RenderPresent(renderer);
-        cap_fps(MAX_FPS);
+        SDL_Delay(1);
     }
 }
 
 /*** Game ***/
 
 typedef struct {
-    Spaceship *spaceships;
+    Spaceships spaceships;
+    Handle player;
     BulletsManager *bullets_manager;
-    Explosion *explosions;
+    Explosions explosions;
+    Particles *particles;
+    Grid grid;
     Uint32 score;
+    float spawn_delay; // seconds until the next enemies spawn
 } Game;
 
-void Game_new(Game *game, SDL_Renderer *renderer) {
-    game->spaceships = Spaceship_new_player_spaceship(renderer);
-    game->bullets_manager = BulletsManager_new();
-    game->explosions = NULL;
+/* `bullets_manager` and `particles` are emptied and reused when starting over */
+void Game_new(Game *game, BulletsManager *bullets_manager, Particles *particles) {
+    Spaceships_init(&game->spaceships);
+    Spaceships_add_player(&game->spaceships, &game->player);
+    BulletsManager_clear(bullets_manager);
+    game->bullets_manager = bullets_manager;
+    Explosions_init(&game->explosions);
+    Particles_clear(particles);
+    game->particles = particles;
+    Grid_init(&game->grid);
     game->score = 0;
+    game->spawn_delay = SPAWN_DELAY;
+}
+
+bool Game_is_over(Game *game) {
+    Uint32 player;
+    return !Pool_lookup(&game->spaceships.pool, game->player, &player)
+        || game->spaceships.health[player].health == 0;
+}
+
+/* Advance the game by one simulation step */
+void Game_update(Game *game, float dt) {
+    Spaceships *spaceships = &game->spaceships;
+    update_stars(dt);
+    move_spaceships(spaceships, &game->grid, game->player, dt);
+    BulletsManager_move_bullets(game->bullets_manager, dt);
+    Uint32 player;
+    if (Pool_lookup(&spaceships->pool, game->player, &player)) {
+        Spaceships_fire(spaceships, player, game->bullets_manager, false, dt);
+    }
+    apply_bullet_hits(spaceships, &game->grid, game->bullets_manager, game->particles);
+    game->score += Spaceships_clean_up(spaceships, game->player, &game->explosions, game->particles);
+    make_enemies_shoot(spaceships, &game->grid, game->player, game->bullets_manager, dt);
+    game->spawn_delay -= dt;
+    if (game->spawn_delay <= 0) {
+        spawn_enemies(spaceships, game->player);
+        game->spawn_delay += SPAWN_DELAY;
+    }
+    Explosions_update(&game->explosions, dt);
+    emit_engine_trails(spaceships, game->particles, dt);
+    Particles_update(game->particles, dt);
+}
+
+/**
+ * Render the game `alpha` (0 to 1) of the way from the previous simulation
+ * step to the last one.
+ */
+void Game_render(Game *game, SDL_Renderer *renderer, float alpha) {
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    render_stars(alpha);
+    render_score(game->score);
+    Particles_render(game->particles, alpha);
+    Spaceships_render(&game->spaceships, alpha);
+    Explosions_render(&game->explosions, alpha);
+    BulletsManager_render_bullets(game->bullets_manager, alpha);
+    render_fps();
+    if (DEBUG) {
+        render_firing_lanes(&game->spaceships, game->player);
+        render_debug_counters();
+    }
+    SpriteBatch_flush(renderer);
+    SDL_RenderPresent(renderer);
+}
+
+/*** Benchmark ***/
+
+#define BENCHMARK_EXPLOSIONS 4
+#define BENCHMARK_BULLETS 1000
+#define BENCHMARK_PARTICLES MAX_PARTICLES
+
+typedef enum {
+    PASS_STARS,
+    PASS_PARTICLES,
+    PASS_SPACESHIPS,
+    PASS_BULLETS,
+    PASS_EXPLOSIONS,
+    PASS_TEXT,
+    PASS_SUBMIT,
+    PASS_END_MARKER // the number of passes
+} PassType;
+
+static char *PASS_NAMES[PASS_END_MARKER] = {
+    "stars", "particles", "ships", "bullets", "explosions", "text", "submit"
+};
+
+typedef struct {
+    Uint64 start, start_calls;
+    Uint64 time;  // in performance counter units
+    Uint64 calls;
+} Pass;
+
+void Pass_begin(Pass *pass) {
+    pass->start = SDL_GetPerformanceCounter();
+    pass->start_calls = draw_calls;
+}
+
+void Pass_end(Pass *pass) {
+    pass->time += SDL_GetPerformanceCounter() - pass->start;
+    pass->calls += draw_calls - pass->start_calls;
+}
+
+/**
+ * Render `frames` frames of a busy scene (the player, a full wave of enemies,
+ * BENCHMARK_BULLETS bullets, a few explosions and as many particles as there
+ * is room for) with the software renderer into an offscreen surface, no
+ * window or GPU needed. Prints the time and number of draw calls per frame for
+ * every draw path, the bullets and particles passes include their update.
+ * Draw paths only fill the sprite batch, which is drawn by the submit pass.
+ * Also prints the size and load time of the textures.
+ */
+void run_benchmark(Uint32 frames) {
+    if (IMG_Init(IMG_INIT_PNG) == 0) {
+        sdl_fail();
+    }
+    // draw calls are executed right away instead of being queued until the
+    // frame is presented, so that every pass is timed on its own
+    SDL_SetHint(SDL_HINT_RENDER_BATCHING, "0");
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(
+        0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_RGBA8888
+    );
+    if (!surface) {
+        sdl_fail();
+    }
+    SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(surface);
+    if (!renderer) {
+        sdl_fail();
+    }
+    // audio is not open, so only the textures are loaded
+    Resources_initialize(renderer);
+    Resources_acquire(RESOURCE_GROUP_GAME_OVER);
+    Resources_wait(RESOURCE_GROUP_GAME_OVER);
+
+    Spaceships spaceships;
+    Spaceships_init(&spaceships);
+    Spaceships_add_player(&spaceships, NULL);
+    for (int i = 0; i < ENEMIES_COUNT; i++) {
+        SDL_Rect rect;
+        rect.w = SPACESHIP_WIDTH / 1.5;
+        rect.h = SPACESHIP_HEIGHT / 1.5;
+        rect.x = (i + 0.5) * SCREEN_WIDTH / ENEMIES_COUNT - rect.w / 2.;
+        rect.y = SCREEN_HEIGHT / 8. * (1 + i % 3);
+        Spaceships_add(&spaceships, NULL, rect, TEXTURE_SPACESHIP_TURNED, 0, ENEMY_HEALTH);
+        // every color of the healthbar
+        spaceships.health[i + 1].health = ENEMY_HEALTH * (i + 1) / ENEMIES_COUNT;
+    }
+    BulletsManager *bullets = BulletsManager_new();
+    Explosions explosions;
+    Explosions_init(&explosions);
+    Particles *particles = Particles_new();
+
+    Pass passes[PASS_END_MARKER] = {0};
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (Uint32 frame = 0; frame < frames; frame++) {
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+
+        // one simulation step per frame, rendered half way
+        update_stars(SIMULATION_STEP);
+        Explosions_update(&explosions, SIMULATION_STEP);
+        float alpha = 0.5;
+
+        Pass_begin(&passes[PASS_STARS]);
+        render_stars(alpha);
+        Pass_end(&passes[PASS_STARS]);
+
+        while (particles->count < BENCHMARK_PARTICLES) {
+            Particles_emit(
+                particles, rand() % SCREEN_WIDTH, rand() % SCREEN_HEIGHT, 0, 0, 20, 150, 2, 3,
+                (SDL_Color){255, 140, 40, 255}
+            );
+        }
+        Pass_begin(&passes[PASS_PARTICLES]);
+        Particles_update(particles, SIMULATION_STEP);
+        Particles_render(particles, alpha);
+        Pass_end(&passes[PASS_PARTICLES]);
+
+        Pass_begin(&passes[PASS_SPACESHIPS]);
+        Spaceships_render(&spaceships, alpha);
+        Pass_end(&passes[PASS_SPACESHIPS]);
+
+        // keep the explosions going, at different steps
+        if (frame % 8 == 0 && explosions.pool.count < BENCHMARK_EXPLOSIONS) {
+            SDL_Rect r = Transform_rect(&spaceships.transform[1 + frame / 8 % ENEMIES_COUNT]);
+            Explosions_add(
+                &explosions, r.x + r.w / 2, r.y + r.h / 2, 0.1, 1.5, EXPLOSION_PEAK_TIME,
+                TEXTURE_EXPLOSION
+            );
+        }
+        Pass_begin(&passes[PASS_EXPLOSIONS]);
+        Explosions_render(&explosions, alpha);
+        Pass_end(&passes[PASS_EXPLOSIONS]);
+
+        // bullets flying both ways, replaced as they leave the screen
+        while (bullets->count < BENCHMARK_BULLETS) {
+            BulletsManager_add(
+                bullets,
+                rand() % (SCREEN_WIDTH - BULLET_WIDTH),
+                rand() % SCREEN_HEIGHT,
+                0,
+                rand() % 2 ? BULLET_SPEED : -BULLET_SPEED
+            );
+        }
+        Pass_begin(&passes[PASS_BULLETS]);
+        BulletsManager_move_bullets(bullets, SIMULATION_STEP);
+        BulletsManager_render_bullets(bullets, alpha);
+        Pass_end(&passes[PASS_BULLETS]);
+
+        Pass_begin(&passes[PASS_TEXT]);
+        render_score(frame);
+        render_fps();
+        Pass_end(&passes[PASS_TEXT]);
+
+        Pass_begin(&passes[PASS_SUBMIT]);
+        SpriteBatch_flush(renderer);
+        Pass_end(&passes[PASS_SUBMIT]);
+
+        SDL_RenderPresent(renderer);
+    }
+    double ms = 1000. / SDL_GetPerformanceFrequency();
+    double total_ms = (SDL_GetPerformanceCounter() - start) * ms;
+
+    printf("%u frames of %dx%d with the software renderer\n", frames, SCREEN_WIDTH, SCREEN_HEIGHT);
+    for (int i = 0; i < PASS_END_MARKER; i++) {
+        printf(
+            "  %-10s %8.3f ms/frame %8.1f calls/frame\n",
+            PASS_NAMES[i], passes[i].time * ms / frames, (double)passes[i].calls / frames
+        );
+    }
+    printf(
+        "  %-10s %8.3f ms/frame %8.1f calls/frame, %.1f fps\n",
+        "total", total_ms / frames, (double)draw_calls / frames, frames * 1000. / total_ms
+    );
+    Resources_print_stats();
+
+    BulletsManager_destroy(bullets);
+    Particles_destroy(particles);
+    SpriteBatch_destroy();
+    Resources_destroy();
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    IMG_Quit();
+    SDL_Quit();
 }
 
 /*** Main ***/
 
-int main() {
+int main(int argc, char **argv) {
+    // ./spaceships --bench [frames]
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        int frames = argc > 2 ? atoi(argv[2]) : 1000;
+        if (frames <= 0) {
+            printf("Usage: %s --bench [frames]\n", argv[0]);
+            return 1;
+        }
+        run_benchmark(frames);
+        return 0;
+    }
+    // ./spaceships --pack
+    if (argc > 1 && strcmp(argv[1], "--pack") == 0) {
+        AssetBundle_pack(ASSET_BUNDLE_FILE_NAME);
+        return 0;
+    }
+
     SDL_Window *window;
     SDL_Renderer *renderer;
     sdl_init(&window, &renderer);
-    TexturesCache_initialize();
-    SoundChunksCache_initialize();
+    Resources_initialize(renderer);
+    Resources_acquire(RESOURCE_GROUP_GAMEPLAY);
+    Resources_wait(RESOURCE_GROUP_GAMEPLAY);
+    Voices_initialize();
 
-    Game game; Game_new(&game, renderer);
-    Spaceship *curr = game.spaceships;
-    Uint32 spawn_delay = SPAWN_DELAY;
+    Game game; Game_new(&game, BulletsManager_new(), Particles_new());
+    Clock clock; Clock_init(&clock);
 
     while(1) {
-        if (Spaceship_is_dead(game.spaceships)) {
-            SoundChunkCache_play(SOUND_CHUNK_LOST);
-            if (show_game_over_screen(renderer, game.score)) {
-                Game_new(&game, renderer);
+        if (Game_is_over(&game)) {
+            play_sound(SOUND_CHUNK_LOST);
+            Resources_acquire(RESOURCE_GROUP_GAME_OVER);
+            Resources_release(RESOURCE_GROUP_GAMEPLAY);
+            bool restart = show_game_over_screen(renderer, game.score);
+            Resources_acquire(RESOURCE_GROUP_GAMEPLAY);
+            Resources_release(RESOURCE_GROUP_GAME_OVER);
+            if (restart) {
+                Resources_wait(RESOURCE_GROUP_GAMEPLAY);
+                Game_new(&game, game.bullets_manager, game.particles);
+                Clock_init(&clock);
             } else {
                 break;
             }
         }
 
-        if (!handle_input(game.spaceships)) {
-            break;
+        Uint32 player;
+        if (!Pool_lookup(&game.spaceships.pool, game.player, &player)) {
+            // the game is over, show it at the top of the loop
+            continue;
         }
-
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
-        render_stars(renderer);
-
-        move_spaceships(game.spaceships);
-        BulletsManager_move_bullets(game.bullets_manager);
-        Spaceship_fire(game.spaceships, game.bullets_manager, renderer, false);
-        apply_bullet_hits(game.spaceships, game.bullets_manager);
-        game.score += Spaceship_clean_up(game.spaceships, &game.explosions, renderer);
-        render_score(renderer, game.score);
-        make_enemies_shoot(game.spaceships, game.bullets_manager, renderer);
-        if (spawn_delay == 0) {
-            spawn_enemies(game.spaceships, renderer);
-            spawn_delay = SPAWN_DELAY;
+        if (!handle_input(&game.spaceships.velocity[player], &game.spaceships.weapon[player])) {
+            break;
         }
-        spawn_delay--;
 
-        Spaceship_render(game.spaceships, renderer);
-        curr = game.spaceships;
-        while(curr != NULL) {
-            Spaceship_render(curr, renderer);
-            curr = curr->next;
+        for (Uint32 steps = Clock_tick(&clock); steps > 0; steps--) {
+            Game_update(&game, SIMULATION_STEP);
         }
-        game.explosions = Explosion_step(game.explosions, renderer);
-        BulletsManager_render_bullets(game.bullets_manager, renderer);
-
-        render_fps(renderer);
-
-        SDL_RenderPresent(renderer);
-        cap_fps(MAX_FPS);
+        Resources_update();
+        Voices_update();
+        Game_render(&game, renderer, Clock_alpha(&clock));
+        SDL_Delay(1);
     }
 
-    Spaceship_destroy(game.spaceships);
     BulletsManager_destroy(game.bullets_manager);
+    Particles_destroy(game.particles);
 
-    TexturesCache_destroy();
-    SoundChunksCache_destroy();
+    if (DEBUG) {
+        Voices_print_stats();
+    }
+    SpriteBatch_destroy();
+    Resources_destroy();
     sdl_destroy(window, renderer);
 }